@@ -0,0 +1,223 @@
+// Runs the solver executables on standard instances and reports speed and solution quality as JSON
+//
+//   benchmark [--manifest benchmarks/instances.txt] [--instances-dir benchmarks/instances]
+//             [--bin-dir <dir of this executable>] [--seeds 1,2,3] [--time-limit 10]
+//             [--chains 1] [--output results.json]
+//
+// Each manifest line names a solver, an instance file and its best-known cost. Every
+// (instance, seed) pair runs the solver once with --instance, --seed, --time-limit and
+// --json; the solver's one-line report is combined with the best-known cost into a gap.
+// A run whose best solution is infeasible counts as a miss: it is listed, but left out of
+// the gaps and time-to-best in the summary.
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "common/cli.h"
+
+using namespace std;
+
+struct BenchmarkCase {
+    string solver;
+    string instance;
+    double best_known;  // <= 0 when unknown
+};
+
+struct RunResult {
+    const BenchmarkCase* bench;
+    uint64_t seed;
+    long iterations;
+    double seconds;
+    double iterations_per_second;
+    double best_cost;
+    bool feasible;
+    double time_to_best;
+
+    double gap() const { return 100.0 * (best_cost - bench->best_known) / bench->best_known; }
+};
+
+vector<BenchmarkCase> readManifest(const string& path) {
+    ifstream file(path);
+    if (!file) {
+        cerr << "Error: Unable to open manifest " << path << endl;
+        exit(1);
+    }
+    vector<BenchmarkCase> cases;
+    string line;
+    while (getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        istringstream fields(line);
+        BenchmarkCase bench;
+        string best_known;
+        if (fields >> bench.solver >> bench.instance >> best_known) {
+            bench.best_known = best_known == "-" ? 0.0 : atof(best_known.c_str());
+            cases.push_back(bench);
+        }
+    }
+    return cases;
+}
+
+vector<uint64_t> parseSeeds(const string& list) {
+    vector<uint64_t> seeds;
+    istringstream fields(list);
+    string seed;
+    while (getline(fields, seed, ',')) {
+        seeds.push_back(strtoull(seed.c_str(), nullptr, 10));
+    }
+    return seeds;
+}
+
+// Value of "key": <number> in a flat one-line JSON object, or NaN.
+double jsonNumber(const string& json, const string& key) {
+    size_t at = json.find("\"" + key + "\":");
+    if (at == string::npos) {
+        return numeric_limits<double>::quiet_NaN();
+    }
+    return atof(json.c_str() + at + key.size() + 3);
+}
+
+// Value of "key": true|false in a flat one-line JSON object; reports without the key are
+// taken as true.
+bool jsonBool(const string& json, const string& key) {
+    size_t at = json.find("\"" + key + "\":");
+    return at == string::npos || json.compare(at + key.size() + 4, 5, "false") != 0;
+}
+
+bool fileExists(const string& path) {
+    return ifstream(path).good();
+}
+
+string directoryOf(const string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == string::npos ? "." : path.substr(0, slash);
+}
+
+// The solver runs under timeout(1) so that a solver that never returns cannot stall the suite.
+bool runCase(const BenchmarkCase& bench, const string& instance_path, const string& bin_dir, uint64_t seed,
+             double time_limit, int chains, RunResult& result) {
+    ostringstream command;
+    command << "timeout " << (int)(2 * time_limit + 30) << " " << bin_dir << "/" << bench.solver << " --instance '"
+            << instance_path << "' --seed " << seed << " --time-limit " << time_limit << " --chains " << chains
+            << " --json 2>/dev/null";
+    FILE* pipe = popen(command.str().c_str(), "r");
+    if (!pipe) {
+        return false;
+    }
+    string report;
+    char buffer[4096];
+    while (fgets(buffer, sizeof(buffer), pipe)) {
+        if (buffer[0] == '{') {
+            report = buffer;
+        }
+    }
+    int status = pclose(pipe);
+    if (status != 0 || report.empty()) {
+        return false;
+    }
+
+    result.bench = &bench;
+    result.seed = seed;
+    result.iterations = (long)jsonNumber(report, "iterations");
+    result.seconds = jsonNumber(report, "seconds");
+    result.iterations_per_second = jsonNumber(report, "iterations_per_second");
+    result.best_cost = jsonNumber(report, "best_cost");
+    result.feasible = jsonBool(report, "feasible");
+    result.time_to_best = jsonNumber(report, "time_to_best");
+    return true;
+}
+
+void writeJson(ostream& out, const vector<BenchmarkCase>& cases, const vector<RunResult>& results,
+               const vector<uint64_t>& seeds, double time_limit, int chains) {
+    out << "{\n  \"time_limit\": " << time_limit << ",\n  \"chains\": " << chains << ",\n  \"seeds\": [";
+    for (int i = 0; i < seeds.size(); ++i) {
+        out << (i ? ", " : "") << seeds[i];
+    }
+    out << "],\n  \"runs\": [";
+    for (int i = 0; i < results.size(); ++i) {
+        const RunResult& r = results[i];
+        out << (i ? "," : "") << "\n    {\"solver\": \"" << r.bench->solver << "\", \"instance\": \"" << r.bench->instance
+            << "\", \"seed\": " << r.seed << ", \"iterations\": " << r.iterations << ", \"seconds\": " << r.seconds
+            << ", \"iterations_per_second\": " << r.iterations_per_second << ", \"time_to_best\": " << r.time_to_best
+            << ", \"best_cost\": " << r.best_cost << ", \"feasible\": " << (r.feasible ? "true" : "false");
+        if (r.bench->best_known > 0) {
+            out << ", \"best_known\": " << r.bench->best_known << ", \"gap\": " << r.gap();
+        }
+        out << "}";
+    }
+
+    // Per-instance means over the seeds that completed; quality over the feasible ones.
+    out << "\n  ],\n  \"summary\": [";
+    bool first = true;
+    for (const BenchmarkCase& bench : cases) {
+        int runs = 0, feasible = 0;
+        double ips = 0.0, ttb = 0.0, gap = 0.0, best_gap = numeric_limits<double>::infinity();
+        for (const RunResult& r : results) {
+            if (r.bench == &bench) {
+                ++runs;
+                ips += r.iterations_per_second;
+                if (r.feasible) {
+                    ++feasible;
+                    ttb += r.time_to_best;
+                    gap += r.gap();
+                    best_gap = min(best_gap, r.gap());
+                }
+            }
+        }
+        if (runs == 0) {
+            continue;
+        }
+        out << (first ? "" : ",") << "\n    {\"solver\": \"" << bench.solver << "\", \"instance\": \"" << bench.instance
+            << "\", \"runs\": " << runs << ", \"feasible_runs\": " << feasible
+            << ", \"mean_iterations_per_second\": " << ips / runs;
+        if (feasible > 0) {
+            out << ", \"mean_time_to_best\": " << ttb / feasible;
+            if (bench.best_known > 0) {
+                out << ", \"mean_gap\": " << gap / feasible << ", \"best_gap\": " << best_gap;
+            }
+        }
+        out << "}";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    string manifest = vrp::stringArg(argc, argv, "--manifest", "benchmarks/instances.txt");
+    string instances_dir = vrp::stringArg(argc, argv, "--instances-dir", "benchmarks/instances");
+    string bin_dir = vrp::stringArg(argc, argv, "--bin-dir", directoryOf(argv[0]));
+    vector<uint64_t> seeds = parseSeeds(vrp::stringArg(argc, argv, "--seeds", "1,2,3"));
+    double time_limit = vrp::doubleArg(argc, argv, "--time-limit", 10.0);
+    int chains = max(1, vrp::intArg(argc, argv, "--chains", 1));
+    string output = vrp::stringArg(argc, argv, "--output", "");
+
+    vector<BenchmarkCase> cases = readManifest(manifest);
+    vector<RunResult> results;
+    for (const BenchmarkCase& bench : cases) {
+        string instance_path = instances_dir + "/" + bench.instance;
+        if (!fileExists(instance_path)) {
+            cerr << "skipping " << bench.instance << ": not found in " << instances_dir << endl;
+            continue;
+        }
+        for (uint64_t seed : seeds) {
+            RunResult result;
+            if (runCase(bench, instance_path, bin_dir, seed, time_limit, chains, result)) {
+                cerr << bench.solver << " " << bench.instance << " seed " << seed << ": " << result.best_cost
+                     << (result.feasible ? "" : " (infeasible)") << endl;
+                results.push_back(result);
+            } else {
+                cerr << bench.solver << " " << bench.instance << " seed " << seed << ": failed" << endl;
+            }
+        }
+    }
+
+    if (output.empty()) {
+        writeJson(cout, cases, results, seeds, time_limit, chains);
+    } else {
+        ofstream file(output);
+        writeJson(file, cases, results, seeds, time_limit, chains);
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Cooling driven by the measured acceptance rate and scaled to an iteration or time budget
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace vrp {
+
+// The budget ends at whichever of `iterations` and `seconds` runs out first; leaving one at
+// 0 disables it. Acceptances are shares of uphill moves accepted.
+struct AdaptiveScheduleOptions {
+    long iterations = 0;
+    double seconds = 0.0;
+    double initial_acceptance = 0.5;   // target at the start of the budget
+    double final_acceptance = 1e-3;    // target at its end
+    int window = 100;                  // uphill moves between temperature adjustments
+    double gain = 0.5;                 // exponent of the feedback correction per window
+    double stagnation = 0.1;           // share of the budget without a new best before a reheat; 0 = never
+    double reheat_acceptance = 0.2;    // target a reheat restarts the decay from
+
+    // A budget of `seconds` when positive, otherwise of `iterations`.
+    static AdaptiveScheduleOptions budget(long iterations, double seconds) {
+        AdaptiveScheduleOptions options;
+        options.iterations = seconds > 0 ? 0 : iterations;
+        options.seconds = seconds;
+        return options;
+    }
+};
+
+// The target acceptance decays geometrically from initial_acceptance to final_acceptance
+// over the budget, so the whole budget is spent searching rather than frozen. The
+// temperature is the one that accepts a reference uphill delta at the target rate, and
+// follows the target every iteration. After every window of uphill moves the reference
+// becomes the window's median delta times a correction that feedback from the measured
+// rate keeps adjusting: the median alone misjudges skewed delta distributions, such as
+// penalty terms mixed with distances. When no new best has turned up for `stagnation` of
+// the budget the target jumps back to reheat_acceptance and decays again over what is
+// left. calibrate() sets where the temperature starts. setTemperature() holds the
+// temperature at t until the next call, for the upper rungs of a tempering ladder, which
+// follow the schedule of the rung below instead of their own.
+class AdaptiveSchedule {
+public:
+    AdaptiveSchedule(double initial_temperature, AdaptiveScheduleOptions options)
+        : temperature_(initial_temperature), options_(options) {
+        restartDecay(options_.initial_acceptance);
+        deltas_.reserve(options_.window);
+        calibrate(initial_temperature);
+    }
+
+    double temperature() const { return temperature_; }
+    void calibrate(double t) {
+        temperature_ = t;
+        held_ = false;
+        reference_delta_ = -t * logTarget();
+    }
+    void setTemperature(double t) {
+        temperature_ = t;
+        held_ = true;
+    }
+    bool frozen() const { return progress_ >= 1.0; }
+    double progress() const { return progress_; }
+    int reheats() const { return reheats_; }
+
+    void improved() { last_improvement_ = progress_; }
+
+    void update(bool accepted, double delta) {
+        if (iteration_++ == 0) {
+            start_ = Clock::now();
+        }
+        if (delta > 0) {
+            deltas_.push_back(delta);
+            accepted_uphill_ += accepted;
+        }
+        if (options_.iterations > 0) {
+            progress_ = std::max(progress_, static_cast<double>(iteration_) / options_.iterations);
+        }
+        if (options_.seconds > 0 && iteration_ % kClockCheckInterval == 0) {
+            progress_ = std::max(progress_, std::chrono::duration<double>(Clock::now() - start_).count() / options_.seconds);
+        }
+        if (static_cast<int>(deltas_.size()) >= options_.window) {
+            adjust();
+        }
+        if (!held_) {
+            temperature_ = reference_delta_ / -logTarget();
+        }
+    }
+
+    // The share of uphill moves the schedule is aiming to accept now.
+    double targetAcceptance() const { return std::exp(logTarget()); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr long kClockCheckInterval = 256;
+
+    double logTarget() const {
+        double span = 1.0 - reheat_progress_;
+        double t = span > 0 ? std::min(1.0, (progress_ - reheat_progress_) / span) : 1.0;
+        return log_start_ + t * log_decay_;
+    }
+
+    void restartDecay(double acceptance) {
+        log_start_ = std::log(acceptance);
+        log_decay_ = std::log(options_.final_acceptance) - log_start_;
+        reheat_progress_ = progress_;
+    }
+
+    void adjust() {
+        if (options_.stagnation > 0 && progress_ - last_improvement_ > options_.stagnation) {
+            restartDecay(options_.reheat_acceptance);
+            last_improvement_ = progress_;
+            ++reheats_;
+        }
+
+        double uphill = static_cast<double>(deltas_.size());
+        double target = targetAcceptance();
+        double rate = accepted_uphill_ / uphill;
+        double floor = 1.0 / uphill;  // one acceptance, so an empty window still corrects
+        correction_ *= std::pow((target + floor) / (rate + floor), options_.gain);
+        correction_ = std::min(std::max(correction_, 1e-6), 1e6);
+
+        std::nth_element(deltas_.begin(), deltas_.begin() + deltas_.size() / 2, deltas_.end());
+        reference_delta_ = correction_ * deltas_[deltas_.size() / 2];
+        deltas_.clear();
+        accepted_uphill_ = 0;
+    }
+
+    double temperature_;
+    AdaptiveScheduleOptions options_;
+    double log_start_ = 0.0;  // log of the acceptance the current decay started from
+    double log_decay_ = 0.0;  // log of final_acceptance over it
+    double reheat_progress_ = 0.0;
+    double last_improvement_ = 0.0;
+    double progress_ = 0.0;
+    double correction_ = 1.0;
+    double reference_delta_ = 0.0;
+    bool held_ = false;  // by setTemperature()
+    long iteration_ = 0;
+    int accepted_uphill_ = 0;
+    int reheats_ = 0;
+    std::vector<double> deltas_;
+    Clock::time_point start_;
+};
+
+}  // namespace vrp
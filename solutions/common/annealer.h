@@ -0,0 +1,230 @@
+// Simulated-annealing loop shared by every VRP variant
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "rng.h"
+#include "telemetry.h"
+
+namespace vrp {
+
+// A Schedule sets the temperature of an Annealer and must provide:
+//   double temperature() const
+//   void setTemperature(double t)
+//   void calibrate(double t)                 set the starting temperature, before the run
+//   bool frozen() const                      the run is over
+//   void update(bool accepted, double delta) once per iteration; delta is 0 when no move was proposed
+//   void improved()                          a new best solution was just recorded
+// AdaptiveSchedule (adaptive_schedule.h) is the budget-driven alternative to this one.
+
+// T <- T * cooling_factor once every plateau_length iterations; frozen once T drops to
+// final_temperature. A temperature that has underflowed out of the normal range accepts no
+// uphill move, so it counts as frozen even when final_temperature is 0.
+class GeometricSchedule {
+public:
+    GeometricSchedule(double initial_temperature, double cooling_factor, double final_temperature = 0.0, int plateau_length = 1)
+        : temperature_(initial_temperature), cooling_factor_(cooling_factor),
+          final_temperature_(final_temperature), plateau_length_(plateau_length) {}
+
+    double temperature() const { return temperature_; }
+    void setTemperature(double t) { temperature_ = t; }
+    void calibrate(double t) { temperature_ = t; }
+    bool frozen() const { return temperature_ <= final_temperature_ || temperature_ < std::numeric_limits<double>::min(); }
+
+    // Called once per iteration, whether or not a move was proposed.
+    void update(bool /*accepted*/, double /*delta*/) {
+        if (++steps_ == plateau_length_) {
+            steps_ = 0;
+            temperature_ *= cooling_factor_;
+        }
+    }
+
+    void improved() {}
+
+private:
+    double temperature_;
+    double cooling_factor_;
+    double final_temperature_;
+    int plateau_length_;
+    int steps_ = 0;
+};
+
+// Runs the Metropolis loop over a Problem, which owns the current solution and must provide:
+//   using Solution = ...;
+//   double cost() const                      cost of the current solution
+//   const Solution& solution() const
+//   void load(const Solution& s)             make s current, rebuilding any caches
+//   bool propose(Move& move, Rng& rng)       draw a move; false when none applies
+//   double evaluate(Move& move)              cost change of move; may apply it in place
+//   void commit(Move& move)                  keep the move; cost() now includes it
+//   void revert(Move& move)                  drop the move, undoing it if evaluate applied it
+//   void resync()                            recompute cost() from scratch
+// Problems with cheap deltas price the move in evaluate() and apply it in commit(); the
+// others apply in evaluate() and undo in revert(). Either way no solution is copied except
+// when a new best is recorded. An Annealer is also a Chain for runParallelChains.
+template <typename Problem, typename Move, typename Schedule>
+class Annealer {
+public:
+    using Solution = typename Problem::Solution;
+    using Clock = std::chrono::steady_clock;
+
+    // The run stops at whichever of time_limit and deadline comes first. on_improvement is
+    // called with the starting solution and then every new best and its cost, from the
+    // thread running the chain, while the search goes on. In builds with VRP_TELEMETRY the
+    // chain counts its moves per operator and samples them into `trace` when one is set.
+    struct Options {
+        int resync_interval = 0;                         // full cost recomputation every N iterations; 0 = never
+        double time_limit = 0.0;                         // seconds from the first run(); 0 = no limit
+        Clock::time_point deadline = Clock::time_point::max();
+        int clock_check_interval = 256;                  // iterations between clock reads when either is set
+        std::function<void(const Solution&, double)> on_improvement;
+        TraceWriter* trace = nullptr;                    // see TraceWriter::configure
+        int trace_chain = 0;
+    };
+
+    Annealer(Problem problem, Schedule schedule, Rng rng, Options options = Options())
+        : problem_(std::move(problem)), schedule_(std::move(schedule)), rng_(rng), options_(options) {
+        best_ = problem_.solution();
+        best_cost_ = problem_.cost();
+        telemetry_.attach(options_.trace, options_.trace_chain);
+    }
+
+    // Returns after `iterations` moves, or earlier once the schedule freezes or the time
+    // limit or deadline passes, with best() holding the best solution so far. The clock is
+    // read only every clock_check_interval iterations.
+    void run(long iterations) {
+        if (!started_) {
+            started_ = true;
+            start_ = Clock::now();
+            deadline_ = options_.deadline;
+            if (options_.time_limit > 0) {
+                deadline_ = std::min(deadline_, start_ + std::chrono::duration_cast<Clock::duration>(
+                                                             std::chrono::duration<double>(options_.time_limit)));
+            }
+            if (options_.on_improvement) {
+                options_.on_improvement(best_, best_cost_);
+            }
+        }
+        bool timed = deadline_ != Clock::time_point::max();
+        long check_interval = std::max(1, options_.clock_check_interval);
+        for (long end = iteration_ + iterations; iteration_ < end && !finished(); ++iteration_) {
+            if (timed && iteration_ % check_interval == 0 && Clock::now() >= deadline_) {
+                timed_out_ = true;
+                break;
+            }
+            bool accepted = false;
+            double delta = 0.0;
+            if (problem_.propose(move_, rng_)) {
+                telemetry_.proposed(move_);
+                delta = problem_.evaluate(move_);
+                accepted = delta < 0 || std::exp(-delta / schedule_.temperature()) > rng_.uniform01();
+                if (accepted) {
+                    telemetry_.accepted(move_, delta < 0);
+                    problem_.commit(move_);
+                } else {
+                    problem_.revert(move_);
+                }
+            }
+
+            if (options_.resync_interval > 0 && (iteration_ + 1) % options_.resync_interval == 0) {
+                problem_.resync();
+            }
+
+            if (problem_.cost() < best_cost_) {
+                if (accepted) {
+                    telemetry_.newBest(move_);
+                }
+                recordBest();
+            }
+
+            schedule_.update(accepted, delta);
+            telemetry_.sample(iteration_, schedule_.temperature(), problem_.cost(), best_cost_);
+        }
+    }
+
+    // Sets the temperature at which a typical uphill move is accepted with probability
+    // `acceptance`, from the median of the uphill deltas of `samples` proposed moves that are
+    // priced and then reverted, so the current solution is unchanged. Returns the
+    // temperature, or leaves it alone and returns it if no sampled move went uphill.
+    double calibrateTemperature(double acceptance, int samples = 200) {
+        std::vector<double> uphill;
+        for (int i = 0; i < samples; ++i) {
+            if (problem_.propose(move_, rng_)) {
+                double delta = problem_.evaluate(move_);
+                problem_.revert(move_);
+                if (delta > 0) {
+                    uphill.push_back(delta);
+                }
+            }
+        }
+        if (!uphill.empty()) {
+            std::nth_element(uphill.begin(), uphill.begin() + uphill.size() / 2, uphill.end());
+            schedule_.calibrate(-uphill[uphill.size() / 2] / std::log(acceptance));
+        }
+        return schedule_.temperature();
+    }
+
+    bool finished() const { return timed_out_ || schedule_.frozen(); }
+    long iterations() const { return iteration_; }
+    double currentCost() const { return problem_.cost(); }
+    double bestCost() const { return best_cost_; }
+    const Solution& best() const { return best_; }
+    double timeToBest() const { return best_time_; }  // seconds from the first run()
+    double temperature() const { return schedule_.temperature(); }
+    void setTemperature(double t) { schedule_.setTemperature(t); }
+
+    Problem& problem() { return problem_; }
+    const Problem& problem() const { return problem_; }
+
+    void adoptBest(const Annealer& other) {
+        problem_.load(other.best_);
+        if (problem_.cost() < best_cost_) {
+            recordBest();
+        }
+    }
+
+    // Replica exchange: the two chains trade current solutions and keep their schedules.
+    void exchange(Annealer& other) {
+        std::swap(problem_, other.problem_);
+        if (problem_.cost() < best_cost_) {
+            recordBest();
+        }
+        if (other.problem_.cost() < other.best_cost_) {
+            other.recordBest();
+        }
+    }
+
+private:
+    void recordBest() {
+        best_ = problem_.solution();
+        best_cost_ = problem_.cost();
+        best_time_ = std::chrono::duration<double>(Clock::now() - start_).count();
+        schedule_.improved();
+        if (options_.on_improvement) {
+            options_.on_improvement(best_, best_cost_);
+        }
+    }
+
+    Problem problem_;
+    Schedule schedule_;
+    Rng rng_;
+    Options options_;
+    Move move_{};
+    SearchTelemetry<Move> telemetry_;
+    long iteration_ = 0;
+    Solution best_;
+    double best_cost_ = std::numeric_limits<double>::infinity();
+    double best_time_ = 0.0;
+    bool started_ = false;
+    bool timed_out_ = false;
+    Clock::time_point start_;
+    Clock::time_point deadline_;
+};
+
+}  // namespace vrp
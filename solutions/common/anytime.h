@@ -0,0 +1,106 @@
+// Wall-clock deadlines and best-so-far streaming for solvers run under a latency budget
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+
+#include "cli.h"
+
+namespace vrp {
+
+// A point in time the whole solve must finish by, fixed when the solver starts so that
+// reading the instance and building initial solutions count against the budget too.
+class Deadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Deadline() = default;  // never
+
+    // `seconds` from now; 0 or less means never.
+    explicit Deadline(double seconds) {
+        if (seconds > 0) {
+            at_ = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        }
+    }
+
+    bool set() const { return at_ != Clock::time_point::max(); }
+    Clock::time_point at() const { return at_; }
+
+    // Seconds left, at least a millisecond so a budget can always be split; 0 if unset.
+    double remaining() const {
+        if (!set()) {
+            return 0.0;
+        }
+        return std::max(1e-3, std::chrono::duration<double>(at_ - Clock::now()).count());
+    }
+
+private:
+    Clock::time_point at_ = Clock::time_point::max();
+};
+
+// Prints one JSON line on stderr per improvement of the best cost across every chain that
+// reports to it, with the seconds since the stream was created, e.g.
+//   {"event": "improvement", "cost": 612.400000, "seconds": 0.013204}
+// Chains improve on their own threads, so reports are serialised and a chain's new best
+// that does not beat another chain's is dropped. A solver running several instances gives
+// each its own stream, labelled with an "instance" field.
+class ProgressStream {
+public:
+    explicit ProgressStream(int instance = -1) : instance_(instance), start_(std::chrono::steady_clock::now()) {}
+
+    void report(double cost) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (best_ == std::numeric_limits<double>::infinity() || cost < best_ - kTolerance * std::abs(best_)) {
+            best_ = cost;
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+            if (instance_ >= 0) {
+                std::fprintf(stderr, "{\"event\": \"improvement\", \"instance\": %d, \"cost\": %.6f, \"seconds\": %.6f}\n",
+                             instance_, cost, seconds);
+            } else {
+                std::fprintf(stderr, "{\"event\": \"improvement\", \"cost\": %.6f, \"seconds\": %.6f}\n", cost, seconds);
+            }
+        }
+    }
+
+private:
+    static constexpr double kTolerance = 1e-9;  // relative; smaller gains are rounding from resyncs
+
+    int instance_;
+    std::mutex mutex_;
+    double best_ = std::numeric_limits<double>::infinity();
+    std::chrono::steady_clock::time_point start_;
+};
+
+// --time-limit SECONDS, --check-interval K (iterations between clock reads) and --progress.
+struct AnytimeOptions {
+    Deadline deadline;
+    int check_interval = 256;
+    bool progress = false;
+
+    // Iterations to run: `fallback`, or unbounded when the deadline ends the run instead.
+    long iterationBudget(long fallback) const { return deadline.set() ? std::numeric_limits<long>::max() : fallback; }
+
+    // Stops an Annealer at the deadline and, under --progress, streams its improvements.
+    template <typename AnnealerOptions>
+    void configure(AnnealerOptions& options, ProgressStream& stream) const {
+        options.deadline = deadline.at();
+        options.clock_check_interval = check_interval;
+        if (progress) {
+            options.on_improvement = [&stream](const auto&, double cost) { stream.report(cost); };
+        }
+    }
+};
+
+inline AnytimeOptions anytimeOptionsFromArgs(int argc, char** argv) {
+    AnytimeOptions options;
+    options.deadline = Deadline(doubleArg(argc, argv, "--time-limit", 0.0));
+    options.check_interval = std::max(1, intArg(argc, argv, "--check-interval", options.check_interval));
+    options.progress = hasFlag(argc, argv, "--progress");
+    return options;
+}
+
+}  // namespace vrp
@@ -0,0 +1,53 @@
+// Minimal "--name value" command-line lookup shared by the solver executables
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace vrp {
+
+inline const char* argValue(int argc, char** argv, const char* name) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], name) == 0) {
+            return argv[i + 1];
+        }
+    }
+    return nullptr;
+}
+
+inline bool hasFlag(int argc, char** argv, const char* name) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline int intArg(int argc, char** argv, const char* name, int fallback) {
+    const char* value = argValue(argc, argv, name);
+    return value ? std::atoi(value) : fallback;
+}
+
+inline double doubleArg(int argc, char** argv, const char* name, double fallback) {
+    const char* value = argValue(argc, argv, name);
+    return value ? std::atof(value) : fallback;
+}
+
+inline std::string stringArg(int argc, char** argv, const char* name, const std::string& fallback) {
+    const char* value = argValue(argc, argv, name);
+    return value ? std::string(value) : fallback;
+}
+
+// --seed N, or the clock when absent. The seed is echoed on stderr so any run can be replayed.
+inline uint64_t seedArg(int argc, char** argv, uint64_t fallback) {
+    const char* value = argValue(argc, argv, "--seed");
+    uint64_t seed = value ? std::strtoull(value, nullptr, 10) : fallback;
+    std::fprintf(stderr, "seed: %llu\n", static_cast<unsigned long long>(seed));
+    return seed;
+}
+
+}  // namespace vrp
@@ -0,0 +1,81 @@
+// Dense distance matrix shared by the solvers
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace vrp {
+
+// Row-major n x n matrix in one contiguous buffer, so a row scan is a linear walk
+// and a lookup is a single multiply-add instead of a sqrt in the inner loop.
+template <typename T>
+class BasicDistanceMatrix {
+public:
+    BasicDistanceMatrix() = default;
+    explicit BasicDistanceMatrix(int n) : n_(n), data_(static_cast<size_t>(n) * n, T(0)) {}
+
+    int size() const { return n_; }
+
+    T operator()(int i, int j) const { return data_[static_cast<size_t>(i) * n_ + j]; }
+    T& at(int i, int j) { return data_[static_cast<size_t>(i) * n_ + j]; }
+
+    const T* row(int i) const { return data_.data() + static_cast<size_t>(i) * n_; }
+    T* row(int i) { return data_.data() + static_cast<size_t>(i) * n_; }
+
+    // Fills every entry with dist(i, j). Rows are split across num_threads workers
+    // (0 = hardware concurrency); small matrices are built on the calling thread.
+    template <typename DistanceFn>
+    static BasicDistanceMatrix build(int n, DistanceFn dist, unsigned num_threads = 0) {
+        BasicDistanceMatrix matrix(n);
+        auto fillRows = [&matrix, &dist, n](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                T* out = matrix.row(i);
+                for (int j = 0; j < n; ++j) {
+                    out[j] = static_cast<T>(dist(i, j));
+                }
+            }
+        };
+
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        const int kMinRowsPerThread = 256;
+        int workers = std::min<int>(num_threads, std::max(1, n / kMinRowsPerThread));
+        if (workers <= 1) {
+            fillRows(0, n);
+            return matrix;
+        }
+
+        std::vector<std::thread> threads;
+        int chunk = (n + workers - 1) / workers;
+        for (int begin = 0; begin < n; begin += chunk) {
+            threads.emplace_back(fillRows, begin, std::min(n, begin + chunk));
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        return matrix;
+    }
+
+    // Euclidean matrix over anything with .x and .y members.
+    template <typename Point>
+    static BasicDistanceMatrix euclidean(const std::vector<Point>& points, unsigned num_threads = 0) {
+        return build(static_cast<int>(points.size()), [&points](int i, int j) {
+            double dx = static_cast<double>(points[i].x) - points[j].x;
+            double dy = static_cast<double>(points[i].y) - points[j].y;
+            return std::sqrt(dx * dx + dy * dy);
+        }, num_threads);
+    }
+
+private:
+    int n_ = 0;
+    std::vector<T> data_;
+};
+
+using DistanceMatrix = BasicDistanceMatrix<double>;
+using DistanceMatrixF = BasicDistanceMatrix<float>;
+
+}  // namespace vrp
@@ -0,0 +1,253 @@
+// Readers for the standard benchmark instance formats (CVRPLIB/TSPLIB, Solomon, Cordeau),
+// parsed straight out of a memory-mapped file
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tokenizer.h"
+
+namespace vrp {
+
+// TSPLIB/CVRPLIB: node 0 is the depot, the remaining nodes are customers in file order.
+struct CvrpInstance {
+    struct Node {
+        double x, y;
+        int demand;
+    };
+
+    std::string name;
+    int capacity = 0;
+    int vehicles = 0;        // the "-kN" suffix of the name; 0 when the name has none
+    bool rounded = false;    // EUC_2D: distances are rounded to the nearest integer
+    std::vector<Node> nodes;
+
+    double distance(int i, int j) const {
+        double d = std::hypot(nodes[i].x - nodes[j].x, nodes[i].y - nodes[j].y);
+        return rounded ? std::floor(d + 0.5) : d;
+    }
+};
+
+// Solomon/Homberger VRPTW: customer 0 is the depot.
+struct SolomonInstance {
+    struct Customer {
+        double x, y;
+        int demand;
+        double ready_time, due_time, service_time;
+    };
+
+    std::string name;
+    int vehicles = 0;
+    int capacity = 0;
+    std::vector<Customer> customers;
+};
+
+// Cordeau's MDVRP (type 2) and PVRP (type 1) files. MDVRP files give a route limit per
+// depot, PVRP files a limit per day and a single depot. A visit pattern is an
+// integer whose binary digits mark the days of the period.
+struct CordeauInstance {
+    struct Limit {
+        double max_duration;   // 0 means unconstrained
+        int capacity;
+    };
+    struct Customer {
+        double x, y;
+        double service_time;
+        int demand;
+        int frequency;
+        std::vector<int> patterns;
+    };
+    struct Point {
+        double x, y;
+    };
+
+    std::string name;
+    int type = 0;
+    int vehicles = 0;          // per depot (MDVRP) or per day (PVRP)
+    int periods = 0;           // depots (MDVRP) or days (PVRP)
+    std::vector<Limit> limits;
+    std::vector<Customer> customers;
+    std::vector<Point> depots;
+};
+
+namespace detail {
+
+inline std::string baseName(const std::string& path) {
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    return name.substr(0, name.find('.'));
+}
+
+inline int vehiclesFromName(std::string_view name) {
+    size_t k = name.rfind("-k");
+    int vehicles = 0;
+    if (k != std::string_view::npos) {
+        std::from_chars(name.data() + k + 2, name.data() + name.size(), vehicles);
+    }
+    return vehicles;
+}
+
+// Runs parse() over the mapped file and prefixes any error with the path.
+template <typename Instance, typename Parse>
+Instance parseInstance(const std::string& path, Parse parse) {
+    try {
+        MappedFile file(path);
+        Tokenizer in(file.text());
+        Instance instance;
+        instance.name = baseName(path);
+        parse(in, instance);
+        return instance;
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+}
+
+}  // namespace detail
+
+inline CvrpInstance loadCvrplib(const std::string& path) {
+    return detail::parseInstance<CvrpInstance>(path, [](Tokenizer& in, CvrpInstance& instance) {
+        int dimension = 0;
+        auto nodeAt = [&](Tokenizer& in) -> CvrpInstance::Node& {
+            int id = in.expect<int>("node id");
+            if (id < 1 || id > dimension) {
+                throw std::runtime_error("node id " + std::to_string(id) + " outside DIMENSION");
+            }
+            return instance.nodes[id - 1];
+        };
+
+        while (!in.atEnd()) {
+            std::string_view line = in.line();
+            if (line == "EOF") {
+                break;
+            }
+            if (line == "NODE_COORD_SECTION") {
+                instance.nodes.resize(dimension);
+                for (int i = 0; i < dimension; ++i) {
+                    CvrpInstance::Node& node = nodeAt(in);
+                    node.x = in.expect<double>("x coordinate");
+                    node.y = in.expect<double>("y coordinate");
+                }
+            } else if (line == "DEMAND_SECTION") {
+                instance.nodes.resize(dimension);
+                for (int i = 0; i < dimension; ++i) {
+                    CvrpInstance::Node& node = nodeAt(in);
+                    node.demand = in.expect<int>("demand");
+                }
+            } else if (line == "DEPOT_SECTION") {
+                int id;
+                while ((id = in.expect<int>("depot id")) != -1) {
+                    if (id != 1) {
+                        throw std::runtime_error("only a single depot at node 1 is supported");
+                    }
+                }
+            } else {
+                size_t colon = line.find(':');
+                if (colon == std::string_view::npos) {
+                    continue;
+                }
+                std::string_view key = Tokenizer::trim(line.substr(0, colon));
+                std::string_view value = Tokenizer::trim(line.substr(colon + 1));
+                if (key == "NAME") {
+                    instance.name = std::string(value);
+                } else if (key == "DIMENSION") {
+                    Tokenizer::parse(value, dimension);
+                } else if (key == "CAPACITY") {
+                    Tokenizer::parse(value, instance.capacity);
+                } else if (key == "EDGE_WEIGHT_TYPE") {
+                    if (value != "EUC_2D" && value != "EXACT_2D") {
+                        throw std::runtime_error("unsupported EDGE_WEIGHT_TYPE " + std::string(value));
+                    }
+                    instance.rounded = value == "EUC_2D";
+                }
+            }
+        }
+
+        if (instance.nodes.empty()) {
+            throw std::runtime_error("no NODE_COORD_SECTION");
+        }
+        instance.vehicles = detail::vehiclesFromName(instance.name);
+    });
+}
+
+inline SolomonInstance loadSolomon(const std::string& path) {
+    return detail::parseInstance<SolomonInstance>(path, [](Tokenizer& in, SolomonInstance& instance) {
+        instance.name = std::string(in.next());
+        while (!in.atEnd() && in.next() != "VEHICLE") {
+        }
+        in.line();
+        in.nextLine();  // NUMBER CAPACITY
+        instance.vehicles = in.expect<int>("vehicle number");
+        instance.capacity = in.expect<int>("vehicle capacity");
+        while (!in.atEnd() && in.next() != "CUSTOMER") {
+        }
+        in.line();
+        in.nextLine();  // column headings
+
+        SolomonInstance::Customer c;
+        int id;
+        while (in.next(id)) {
+            c.x = in.expect<double>("x coordinate");
+            c.y = in.expect<double>("y coordinate");
+            c.demand = in.expect<int>("demand");
+            c.ready_time = in.expect<double>("ready time");
+            c.due_time = in.expect<double>("due date");
+            c.service_time = in.expect<double>("service time");
+            instance.customers.push_back(c);
+        }
+
+        if (instance.customers.empty()) {
+            throw std::runtime_error("no customers");
+        }
+    });
+}
+
+inline CordeauInstance loadCordeau(const std::string& path) {
+    return detail::parseInstance<CordeauInstance>(path, [](Tokenizer& in, CordeauInstance& instance) {
+        instance.type = in.expect<int>("problem type");
+        instance.vehicles = in.expect<int>("vehicle count");
+        int num_customers = in.expect<int>("customer count");
+        instance.periods = in.expect<int>("depot or day count");
+        instance.limits.resize(instance.periods);
+        for (CordeauInstance::Limit& limit : instance.limits) {
+            limit.max_duration = in.expect<double>("maximum route duration");
+            limit.capacity = in.expect<int>("vehicle capacity");
+        }
+        in.line();
+
+        // Customers are numbered 1..n. Depots are numbered 0 (PVRP, listed first) or n+1..
+        // (MDVRP, listed last); only their coordinates are read.
+        instance.customers.resize(num_customers);
+        while (!in.atEnd()) {
+            Tokenizer fields(in.line());
+            int id;
+            double x, y;
+            if (!fields.next(id) || !fields.next(x) || !fields.next(y)) {
+                continue;
+            }
+            if (id < 1 || id > num_customers) {
+                instance.depots.push_back({x, y});
+                continue;
+            }
+            CordeauInstance::Customer& c = instance.customers[id - 1];
+            c.x = x;
+            c.y = y;
+            c.service_time = fields.expect<double>("service time");
+            c.demand = fields.expect<int>("demand");
+            c.frequency = fields.expect<int>("visit frequency");
+            c.patterns.resize(fields.expect<int>("pattern count"));
+            for (int& pattern : c.patterns) {
+                pattern = fields.expect<int>("visit pattern");
+            }
+        }
+
+        int num_depots = instance.type == 2 ? instance.periods : 1;
+        if (static_cast<int>(instance.depots.size()) != num_depots) {
+            throw std::runtime_error("expected " + std::to_string(num_depots) + " depots");
+        }
+    });
+}
+
+}  // namespace vrp
@@ -0,0 +1,126 @@
+// k-nearest-neighbour candidate lists for granular neighbourhoods
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace vrp {
+
+// For each point the k closest other points, nearest first, stored flat (n * k). Built
+// with a uniform grid (about two points per cell) searched in growing rings, so the
+// cost is roughly O(n k log k) instead of the O(n^2) of a full scan.
+class NeighborLists {
+public:
+    NeighborLists() = default;
+
+    int k() const { return k_; }
+    const int* of(int i) const { return data_.data() + static_cast<size_t>(i) * k_; }
+
+    // Only points[begin, end) take part (end = -1 means all), which keeps depots that
+    // share the coordinate vector out of the lists. Rows outside the range are unused.
+    template <typename Point>
+    static NeighborLists build(const std::vector<Point>& points, int k, int begin = 0, int end = -1) {
+        if (end < 0) {
+            end = static_cast<int>(points.size());
+        }
+        int count = end - begin;
+        NeighborLists lists;
+        lists.k_ = std::max(0, std::min(k, count - 1));
+        lists.data_.assign(points.size() * lists.k_, -1);
+        if (lists.k_ == 0) {
+            return lists;
+        }
+
+        double min_x = points[begin].x, max_x = min_x, min_y = points[begin].y, max_y = min_y;
+        for (int i = begin; i < end; ++i) {
+            min_x = std::min<double>(min_x, points[i].x);
+            max_x = std::max<double>(max_x, points[i].x);
+            min_y = std::min<double>(min_y, points[i].y);
+            max_y = std::max<double>(max_y, points[i].y);
+        }
+        int side = std::max(1, static_cast<int>(std::sqrt(count / 2.0)));
+        double cell = std::max({max_x - min_x, max_y - min_y, 1e-9}) / side;
+        auto cellOf = [&](double v, double lo) { return std::min(side - 1, static_cast<int>((v - lo) / cell)); };
+
+        // Counting sort of the points into cells.
+        std::vector<int> cell_start(side * side + 1, 0), cell_points(count);
+        for (int i = begin; i < end; ++i) {
+            ++cell_start[cellOf(points[i].y, min_y) * side + cellOf(points[i].x, min_x) + 1];
+        }
+        for (int c = 0; c < side * side; ++c) {
+            cell_start[c + 1] += cell_start[c];
+        }
+        std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+        for (int i = begin; i < end; ++i) {
+            cell_points[fill[cellOf(points[i].y, min_y) * side + cellOf(points[i].x, min_x)]++] = i;
+        }
+
+        std::vector<std::pair<double, int>> candidates;
+        for (int i = begin; i < end; ++i) {
+            int cx = cellOf(points[i].x, min_x);
+            int cy = cellOf(points[i].y, min_y);
+            candidates.clear();
+            for (int ring = 0; ring < side; ++ring) {
+                for (int y = cy - ring; y <= cy + ring; ++y) {
+                    if (y < 0 || y >= side) continue;
+                    bool edge_row = (y == cy - ring || y == cy + ring);
+                    for (int x = cx - ring; x <= cx + ring; x += (edge_row || ring == 0) ? 1 : 2 * ring) {
+                        if (x < 0 || x >= side) continue;
+                        int c = y * side + x;
+                        for (int p = cell_start[c]; p < cell_start[c + 1]; ++p) {
+                            int j = cell_points[p];
+                            if (j == i) continue;
+                            double dx = static_cast<double>(points[i].x) - points[j].x;
+                            double dy = static_cast<double>(points[i].y) - points[j].y;
+                            candidates.emplace_back(dx * dx + dy * dy, j);
+                        }
+                    }
+                }
+                if (static_cast<int>(candidates.size()) >= lists.k_) {
+                    std::nth_element(candidates.begin(), candidates.begin() + (lists.k_ - 1), candidates.end());
+                    candidates.resize(lists.k_);
+                    // Anything in a later ring is at least ring * cell away.
+                    double reach = ring * cell;
+                    double worst = std::max_element(candidates.begin(), candidates.end())->first;
+                    if (worst <= reach * reach) break;
+                }
+            }
+            std::sort(candidates.begin(), candidates.end());
+            int* out = lists.data_.data() + static_cast<size_t>(i) * lists.k_;
+            for (int n = 0; n < lists.k_; ++n) {
+                out[n] = candidates[n].second;
+            }
+        }
+        return lists;
+    }
+
+private:
+    int k_ = 0;
+    std::vector<int> data_;
+};
+
+// Route and position of every customer, so a neighbour drawn from a list can be located
+// in O(1). Swap moves keep it current with place().
+struct RoutePositions {
+    std::vector<int> route;  // -1 while the customer is not on any route
+    std::vector<int> index;
+
+    void rebuild(const std::vector<std::vector<int>>& routes, int num_nodes) {
+        route.assign(num_nodes, -1);
+        index.assign(num_nodes, -1);
+        for (int r = 0; r < static_cast<int>(routes.size()); ++r) {
+            for (int i = 0; i < static_cast<int>(routes[r].size()); ++i) {
+                place(routes[r][i], r, i);
+            }
+        }
+    }
+
+    void place(int customer, int r, int i) {
+        route[customer] = r;
+        index[customer] = i;
+    }
+};
+
+}  // namespace vrp
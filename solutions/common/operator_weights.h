@@ -0,0 +1,101 @@
+// Roulette-wheel choice among move operators, with weights that adapt to how well each pays off
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cli.h"
+#include "rng.h"
+
+namespace vrp {
+
+// Operator k is drawn with probability weight[k] / sum of weights. When adaptive, every
+// `segment` uses the weights move towards the mean reward per use each operator earned
+// over the segment, by a share `reaction`, with a floor so that no operator dies out:
+//   w <- (1 - reaction) * w + reaction * reward / uses
+// Rewards are the caller's; the usual ones score a new best highest, then an improvement,
+// then an accepted uphill move.
+class OperatorWeights {
+public:
+    OperatorWeights() = default;
+
+    explicit OperatorWeights(std::vector<double> initial, bool adaptive = true, int segment = 500, double reaction = 0.2,
+                             double floor = 0.05)
+        : weights_(std::move(initial)), rewards_(weights_.size(), 0.0), uses_(weights_.size(), 0), adaptive_(adaptive),
+          segment_(std::max(1, segment)), reaction_(reaction), floor_(floor) {
+        for (double& w : weights_) {
+            w = std::max(w, 0.0);
+        }
+    }
+
+    int size() const { return static_cast<int>(weights_.size()); }
+    double weight(int k) const { return weights_[k]; }
+
+    int sample(Rng& rng) const {
+        double total = 0.0;
+        for (double w : weights_) {
+            total += w;
+        }
+        double r = rng.uniform01() * total;
+        for (int k = 0; k + 1 < size(); ++k) {
+            if (r < weights_[k]) {
+                return k;
+            }
+            r -= weights_[k];
+        }
+        return size() - 1;
+    }
+
+    // One proposal of operator k that reached evaluation.
+    void used(int k) {
+        if (!adaptive_) {
+            return;
+        }
+        ++uses_[k];
+        if (++since_update_ == segment_) {
+            update();
+        }
+    }
+
+    void reward(int k, double score) { rewards_[k] += score; }
+
+private:
+    void update() {
+        for (int k = 0; k < size(); ++k) {
+            if (uses_[k] > 0 && weights_[k] > 0) {
+                weights_[k] = std::max(floor_, (1.0 - reaction_) * weights_[k] + reaction_ * rewards_[k] / uses_[k]);
+            }
+            rewards_[k] = 0.0;
+            uses_[k] = 0;
+        }
+        since_update_ = 0;
+    }
+
+    std::vector<double> weights_;
+    std::vector<double> rewards_;
+    std::vector<long> uses_;
+    bool adaptive_ = false;
+    int segment_ = 500;
+    double reaction_ = 0.2;
+    double floor_ = 0.05;
+    int since_update_ = 0;
+};
+
+// --operator-weights w1,w2,... (one per operator, in order; a 0 disables one) and
+// --fixed-weights to keep them instead of adapting them.
+inline OperatorWeights operatorWeightsFromArgs(int argc, char** argv, int num_operators) {
+    std::vector<double> weights(num_operators, 1.0);
+    std::string list = stringArg(argc, argv, "--operator-weights", "");
+    std::stringstream fields(list);
+    std::string field;
+    for (int k = 0; k < num_operators && std::getline(fields, field, ','); ++k) {
+        weights[k] = std::atof(field.c_str());
+    }
+    return OperatorWeights(weights, !hasFlag(argc, argv, "--fixed-weights"));
+}
+
+}  // namespace vrp
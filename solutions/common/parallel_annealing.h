@@ -0,0 +1,115 @@
+// Runs several annealing chains on a thread pool and synchronises them periodically
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "cli.h"
+#include "rng.h"
+#include "thread_pool.h"
+
+namespace vrp {
+
+struct ParallelOptions {
+    int num_chains = 1;
+    int exchange_interval = 1000;     // iterations each chain runs between synchronisations
+    bool parallel_tempering = false;  // replica exchange on a temperature ladder instead of best-solution sharing
+    double ladder_ratio = 1.5;        // temperature ratio between neighbouring ladder rungs
+};
+
+// A Chain is one independent annealing run and must provide:
+//   void run(long iterations)           advance the chain, cooling as it goes
+//   bool finished() const               frozen or out of time; run() then does nothing
+//   double currentCost() const
+//   double bestCost() const
+//   double temperature() const
+//   void setTemperature(double t)
+//   void adoptBest(const Chain& other)  continue from other's best solution
+//   void exchange(Chain& other)         swap current solutions, each chain keeping its schedule
+//
+// Without tempering every chain restarts from the global best at each exchange. With
+// tempering chain k is rung k of a ladder at ladder_ratio^k times the temperature of chain
+// 0, whose schedule leads the cooling: the ladder is laid again from chain 0 before every
+// exchange until chain 0 finishes, after which the others finish on their own, and
+// neighbouring rungs then swap solutions, not temperatures, with the usual Metropolis
+// criterion, drawn from rng. Returns the index of the chain holding the best solution.
+template <typename Chain>
+int runParallelChains(std::vector<Chain>& chains, long iterations, const ParallelOptions& options, ThreadPool& pool, Rng& rng) {
+    int n = static_cast<int>(chains.size());
+    int interval = std::max(1, options.exchange_interval);
+
+    auto layLadder = [&chains, &options, n] {
+        for (int k = 1; k < n; ++k) {
+            chains[k].setTemperature(chains[k - 1].temperature() * options.ladder_ratio);
+        }
+    };
+    if (options.parallel_tempering) {
+        layLadder();
+    }
+
+    auto bestChain = [&chains, n] {
+        int best = 0;
+        for (int k = 1; k < n; ++k) {
+            if (chains[k].bestCost() < chains[best].bestCost()) {
+                best = k;
+            }
+        }
+        return best;
+    };
+
+    auto allFinished = [&chains] {
+        return std::all_of(chains.begin(), chains.end(), [](const Chain& chain) { return chain.finished(); });
+    };
+
+    for (long done = 0; done < iterations && !allFinished(); done += interval) {
+        long epoch = std::min<long>(interval, iterations - done);
+        pool.parallelFor(n, [&chains, epoch](int k) { chains[k].run(epoch); });
+
+        if (options.parallel_tempering) {
+            if (!chains[0].finished()) {
+                layLadder();
+            }
+            for (int k = 0; k + 1 < n; ++k) {
+                Chain& cold = chains[k];
+                Chain& hot = chains[k + 1];
+                double exponent = (1.0 / cold.temperature() - 1.0 / hot.temperature()) * (cold.currentCost() - hot.currentCost());
+                if (exponent >= 0.0 || std::exp(exponent) > rng.uniform01()) {
+                    cold.exchange(hot);
+                }
+            }
+        } else {
+            int best = bestChain();
+            for (int k = 0; k < n; ++k) {
+                if (k != best) {
+                    chains[k].adoptBest(chains[best]);
+                }
+            }
+        }
+    }
+
+    return bestChain();
+}
+
+// Runs a single chain inline, or several on a pool sized to the machine.
+template <typename Chain>
+int runChains(std::vector<Chain>& chains, long iterations, const ParallelOptions& options, Rng& rng) {
+    if (chains.size() == 1) {
+        chains[0].run(iterations);
+        return 0;
+    }
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(std::min<unsigned>(static_cast<unsigned>(chains.size()), hardware));
+    return runParallelChains(chains, iterations, options, pool, rng);
+}
+
+// --chains N, --exchange-interval K and --tempering.
+inline ParallelOptions parallelOptionsFromArgs(int argc, char** argv, int default_exchange_interval) {
+    ParallelOptions options;
+    options.num_chains = std::max(1, intArg(argc, argv, "--chains", 1));
+    options.exchange_interval = intArg(argc, argv, "--exchange-interval", default_exchange_interval);
+    options.parallel_tempering = hasFlag(argc, argv, "--tempering");
+    return options;
+}
+
+}  // namespace vrp
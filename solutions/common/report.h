@@ -0,0 +1,57 @@
+// One-line JSON run summary printed by solvers under --json and read by the benchmark driver
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace vrp {
+
+class Stopwatch {
+public:
+    Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+    double seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count(); }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+struct RunReport {
+    std::string solver;
+    std::string instance;
+    uint64_t seed = 0;
+    int chains = 1;
+    long iterations = 0;      // summed over all chains
+    double seconds = 0.0;     // wall time of the annealing phase
+    double best_cost = 0.0;   // route distance, without penalties, when the solver has them
+    bool feasible = true;     // the best solution meets every constraint
+    double time_to_best = 0.0;
+
+    double iterationsPerSecond() const { return seconds > 0 ? iterations / seconds : 0.0; }
+
+    // Fills the search statistics from annealers that have finished running.
+    template <typename Chain>
+    void collect(const std::vector<Chain>& all, int best_chain, double elapsed) {
+        chains = static_cast<int>(all.size());
+        iterations = 0;
+        for (const Chain& chain : all) {
+            iterations += chain.iterations();
+        }
+        seconds = elapsed;
+        best_cost = all[best_chain].bestCost();
+        time_to_best = all[best_chain].timeToBest();
+    }
+
+    void print(std::FILE* out = stdout) const {
+        std::fprintf(out,
+                     "{\"solver\": \"%s\", \"instance\": \"%s\", \"seed\": %llu, \"chains\": %d, \"iterations\": %ld, "
+                     "\"seconds\": %.6f, \"iterations_per_second\": %.1f, \"best_cost\": %.6f, \"feasible\": %s, "
+                     "\"time_to_best\": %.6f}\n",
+                     solver.c_str(), instance.c_str(), static_cast<unsigned long long>(seed), chains, iterations,
+                     seconds, iterationsPerSecond(), best_cost, feasible ? "true" : "false", time_to_best);
+    }
+};
+
+}  // namespace vrp
@@ -0,0 +1,112 @@
+// Vehicles indexed by spare capacity, for drawing a random vehicle that still fits a demand
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "rng.h"
+
+namespace vrp {
+
+// One bucket of vehicles per residual capacity 0..max_residual, with a Fenwick tree over
+// the bucket sizes. Moving a vehicle between buckets and drawing a uniformly random
+// vehicle with residual >= demand are both O(log max_residual), however full the fleet.
+// Residuals outside the range are clamped into it.
+class ResidualCapacityIndex {
+public:
+    ResidualCapacityIndex() = default;
+
+    ResidualCapacityIndex(int num_vehicles, int max_residual)
+        : tree_(max_residual + 2, 0), buckets_(max_residual + 1), bucket_of_(num_vehicles, -1), slot_(num_vehicles, -1) {}
+
+    void insert(int vehicle, int residual) {
+        int bucket = std::min(std::max(residual, 0), static_cast<int>(buckets_.size()) - 1);
+        bucket_of_[vehicle] = bucket;
+        slot_[vehicle] = static_cast<int>(buckets_[bucket].size());
+        buckets_[bucket].push_back(vehicle);
+        add(bucket, 1);
+    }
+
+    void erase(int vehicle) {
+        int bucket = bucket_of_[vehicle];
+        std::vector<int>& members = buckets_[bucket];
+        int last = members.back();
+        members[slot_[vehicle]] = last;
+        slot_[last] = slot_[vehicle];
+        members.pop_back();
+        add(bucket, -1);
+        bucket_of_[vehicle] = slot_[vehicle] = -1;
+    }
+
+    void update(int vehicle, int residual) {
+        erase(vehicle);
+        insert(vehicle, residual);
+    }
+
+    // Vehicles with residual >= demand.
+    int countAtLeast(int demand) const { return countBelow(static_cast<int>(buckets_.size())) - countBelow(demand); }
+
+    // A uniformly random vehicle with residual >= demand other than `excluded`, or -1 if
+    // there is none.
+    int sample(int demand, Rng& rng, int excluded = -1) const {
+        demand = std::max(demand, 0);
+        if (demand >= static_cast<int>(buckets_.size())) {
+            return -1;
+        }
+        int below = countBelow(demand);
+        int count = countBelow(static_cast<int>(buckets_.size())) - below;
+        int excluded_rank = -1;
+        if (excluded >= 0 && bucket_of_[excluded] >= demand) {
+            excluded_rank = countBelow(bucket_of_[excluded]) + slot_[excluded];
+            --count;
+        }
+        if (count <= 0) {
+            return -1;
+        }
+        int rank = below + rng.uniformInt(count);
+        if (excluded_rank >= 0 && rank >= excluded_rank) {
+            ++rank;
+        }
+        return at(rank);
+    }
+
+private:
+    // Fenwick tree over bucket sizes; tree_[i] covers buckets (i - lowbit(i), i - 1].
+    void add(int bucket, int delta) {
+        for (int i = bucket + 1; i < static_cast<int>(tree_.size()); i += i & -i) {
+            tree_[i] += delta;
+        }
+    }
+
+    // Vehicles in buckets [0, bucket).
+    int countBelow(int bucket) const {
+        int count = 0;
+        for (int i = bucket; i > 0; i -= i & -i) {
+            count += tree_[i];
+        }
+        return count;
+    }
+
+    // The vehicle of the given rank when vehicles are ordered by bucket, then slot.
+    int at(int rank) const {
+        int bucket = 0;
+        int step = 1;
+        while (step * 2 < static_cast<int>(tree_.size())) {
+            step *= 2;
+        }
+        for (; step > 0; step /= 2) {
+            if (bucket + step < static_cast<int>(tree_.size()) && tree_[bucket + step] <= rank) {
+                bucket += step;
+                rank -= tree_[bucket];
+            }
+        }
+        return buckets_[bucket][rank];
+    }
+
+    std::vector<int> tree_;
+    std::vector<std::vector<int>> buckets_;
+    std::vector<int> bucket_of_;
+    std::vector<int> slot_;
+};
+
+}  // namespace vrp
@@ -0,0 +1,98 @@
+// Small seedable random engine passed explicitly to the solvers
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace vrp {
+
+// xoshiro256** (Blackman & Vigna). Each annealing chain owns one, so chains never share
+// generator state, and a fixed seed reproduces a run exactly. Satisfies
+// UniformRandomBitGenerator, so it also works with std::shuffle.
+class Rng {
+public:
+    using result_type = uint64_t;
+
+    explicit Rng(uint64_t seed = 0x9E3779B97F4A7C15ull) { reseed(seed); }
+
+    void reseed(uint64_t seed) {
+        // Expand the seed with splitmix64 so that nearby seeds give unrelated states.
+        for (auto& word : s_) {
+            seed += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() { return next(); }
+
+    uint64_t next() {
+        uint64_t result = rotl(s_[1] * 5, 7) * 9;
+        uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    // Uniform integer in [0, n) by multiply-shift; n must be positive.
+    int uniformInt(int n) {
+        return static_cast<int>(((next() >> 32) * static_cast<uint64_t>(n)) >> 32);
+    }
+
+    // Uniform integer in [lo, hi].
+    int uniformInt(int lo, int hi) { return lo + uniformInt(hi - lo + 1); }
+
+    // Uniform double in [0, 1).
+    double uniform01() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+    double uniform(double lo, double hi) { return lo + (hi - lo) * uniform01(); }
+
+    // Advances the state by 2^128 steps; successive jumps give non-overlapping streams
+    // for parallel chains.
+    void jump() {
+        static const uint64_t kJump[] = {0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull,
+                                         0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull};
+        uint64_t t[4] = {0, 0, 0, 0};
+        for (uint64_t word : kJump) {
+            for (int b = 0; b < 64; ++b) {
+                if (word & (uint64_t(1) << b)) {
+                    for (int i = 0; i < 4; ++i) {
+                        t[i] ^= s_[i];
+                    }
+                }
+                next();
+            }
+        }
+        for (int i = 0; i < 4; ++i) {
+            s_[i] = t[i];
+        }
+    }
+
+    // Returns a copy of this engine and jumps this one past it.
+    Rng split() {
+        Rng child = *this;
+        jump();
+        return child;
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t s_[4];
+};
+
+inline uint64_t timeSeed() {
+    return static_cast<uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+}
+
+}  // namespace vrp
@@ -0,0 +1,140 @@
+// Monte Carlo demand scenarios and the expected restocking cost of a route under them
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "rng.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VRP_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
+
+namespace vrp {
+
+namespace detail {
+
+constexpr int kScenarioBatch = 32;  // four AVX2 registers of floats per pass over a route
+
+// Both kernels walk the route once per batch of scenarios with the batch's loads held in
+// registers, and sum the batch in the same lane order, so they give identical results.
+inline double recourseScalar(const float* demands, size_t stride, const int* route, int length,
+                             const float* round_trip, float capacity) {
+    float total[kScenarioBatch] = {};
+    for (size_t b = 0; b < stride; b += kScenarioBatch) {
+        float load[kScenarioBatch] = {};
+        for (int k = 0; k < length; ++k) {
+            const float* demand = demands + route[k] * stride + b;
+            for (int lane = 0; lane < kScenarioBatch; ++lane) {
+                load[lane] += demand[lane];
+                if (load[lane] > capacity) {
+                    total[lane] += round_trip[route[k]];
+                    load[lane] -= capacity;
+                }
+            }
+        }
+    }
+    double sum = 0.0;
+    for (float lane : total) {
+        sum += lane;
+    }
+    return sum;
+}
+
+#ifdef VRP_AVX2_KERNEL
+__attribute__((target("avx2"))) inline double recourseAvx2(const float* demands, size_t stride,
+                                                           const int* route, int length, const float* round_trip,
+                                                           float capacity) {
+    const __m256 cap = _mm256_set1_ps(capacity);
+    __m256 total[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+    for (size_t b = 0; b < stride; b += kScenarioBatch) {
+        __m256 load[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+        for (int k = 0; k < length; ++k) {
+            const float* demand = demands + route[k] * stride + b;
+            const __m256 trip = _mm256_set1_ps(round_trip[route[k]]);
+            for (int r = 0; r < 4; ++r) {
+                load[r] = _mm256_add_ps(load[r], _mm256_loadu_ps(demand + 8 * r));
+                __m256 failed = _mm256_cmp_ps(load[r], cap, _CMP_GT_OQ);
+                total[r] = _mm256_add_ps(total[r], _mm256_and_ps(failed, trip));
+                load[r] = _mm256_sub_ps(load[r], _mm256_and_ps(failed, cap));
+            }
+        }
+    }
+    float lanes[kScenarioBatch];
+    for (int r = 0; r < 4; ++r) {
+        _mm256_storeu_ps(lanes + 8 * r, total[r]);
+    }
+    double sum = 0.0;
+    for (float lane : lanes) {
+        sum += lane;
+    }
+    return sum;
+}
+
+inline bool cpuHasAvx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+}  // namespace detail
+
+// Sampled demands of every node, one row per node with its scenarios contiguous and
+// zero-padded to a whole batch, so a route walk reads each stop's demands as SIMD vectors.
+// The scenarios are drawn once and every evaluation reuses them (common random numbers):
+// two candidate routes are compared on the same draws, which removes most of the sampling
+// noise from their difference.
+class DemandScenarios {
+public:
+    DemandScenarios() = default;
+
+    // Normal demands, clipped to [0, capacity] so that a single restocking trip always
+    // covers one stop.
+    DemandScenarios(const std::vector<double>& mean, const std::vector<double>& stddev, int scenarios, double capacity,
+                    Rng& rng)
+        : scenarios_(scenarios),
+          stride_((scenarios + detail::kScenarioBatch - 1) / detail::kScenarioBatch * detail::kScenarioBatch),
+          demands_(mean.size() * stride_, 0.0f) {
+        for (size_t node = 0; node < mean.size(); ++node) {
+            float* row = demands_.data() + node * stride_;
+            for (int s = 0; s < scenarios; ++s) {
+                double sample = mean[node] + stddev[node] * standardNormal(rng);
+                row[s] = static_cast<float>(std::min(std::max(sample, 0.0), capacity));
+            }
+        }
+    }
+
+    int scenarios() const { return scenarios_; }
+    const float* demands(int node) const { return demands_.data() + node * stride_; }
+
+    // Expected cost of detour-to-depot recourse along a route: the vehicle leaves the depot
+    // with `capacity` and, whenever a stop's demand exhausts it, drives back to restock and
+    // returns, paying round_trip[stop].
+    double expectedRecourse(const int* route, int length, const float* round_trip, double capacity) const {
+        if (length == 0 || scenarios_ == 0) {
+            return 0.0;
+        }
+        float cap = static_cast<float>(capacity);
+#ifdef VRP_AVX2_KERNEL
+        if (detail::cpuHasAvx2()) {
+            return detail::recourseAvx2(demands_.data(), stride_, route, length, round_trip, cap) / scenarios_;
+        }
+#endif
+        return detail::recourseScalar(demands_.data(), stride_, route, length, round_trip, cap) / scenarios_;
+    }
+
+private:
+    static double standardNormal(Rng& rng) {
+        double u = 1.0 - rng.uniform01();
+        return std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * M_PI * rng.uniform01());
+    }
+
+    int scenarios_ = 0;
+    size_t stride_ = 0;
+    std::vector<float> demands_;
+};
+
+}  // namespace vrp
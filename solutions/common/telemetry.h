@@ -0,0 +1,282 @@
+// Per-operator search counters sampled into a trace file, compiled in with VRP_TELEMETRY
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cli.h"
+
+#ifndef VRP_TELEMETRY
+#define VRP_TELEMETRY 0
+#endif
+
+namespace vrp {
+
+// A Move type with several operators names them and reports its own:
+//   static constexpr const char* kOperators[] = {"swap", "relocate"};
+//   int operatorIndex() const
+// Moves without them count as one operator called "move".
+template <typename Move, typename = void>
+struct MoveOperators {
+    static std::vector<std::string> names() { return {"move"}; }
+    static int of(const Move&) { return 0; }
+};
+
+template <typename Move>
+struct MoveOperators<Move, std::void_t<decltype(Move::kOperators), decltype(std::declval<const Move&>().operatorIndex())>> {
+    static std::vector<std::string> names() { return std::vector<std::string>(std::begin(Move::kOperators), std::end(Move::kOperators)); }
+    static int of(const Move& move) { return move.operatorIndex(); }
+};
+
+// Totals since the chain started. A move is improving when it lowers the current cost,
+// and new-best when it also lowers the best.
+struct OperatorCounters {
+    long proposed = 0;
+    long accepted = 0;
+    long improving = 0;
+    long new_best = 0;
+};
+
+// One row of a trace. acceptance and moves_per_second cover the iterations since the
+// previous sample of the same chain.
+struct TraceSample {
+    int chain = 0;
+    long iteration = 0;
+    double seconds = 0.0;
+    double temperature = 0.0;
+    double current_cost = 0.0;
+    double best_cost = 0.0;
+    double acceptance = 0.0;
+    double moves_per_second = 0.0;
+};
+
+// The trace file shared by every chain of a solver. The format follows the extension:
+// JSON lines for .json and .jsonl, CSV otherwise, with one column group of counters per
+// operator. Chains write whole batches of samples under a lock.
+class TraceWriter {
+public:
+    TraceWriter() = default;  // disabled
+
+    TraceWriter(const std::string& path, std::vector<std::string> operators, int sample_interval, long flush_interval)
+        : operators_(std::move(operators)), sample_interval_(std::max(1, sample_interval)),
+          flush_interval_(std::max(1L, flush_interval)) {
+        if (path.empty()) {
+            return;
+        }
+        if (!VRP_TELEMETRY) {
+            std::fprintf(stderr, "--trace ignored: built without VRP_TELEMETRY\n");
+            return;
+        }
+        file_ = std::fopen(path.c_str(), "w");
+        if (!file_) {
+            std::fprintf(stderr, "cannot write trace %s\n", path.c_str());
+            return;
+        }
+        json_ = endsWith(path, ".json") || endsWith(path, ".jsonl");
+        if (!json_) {
+            std::fprintf(file_, "chain,iteration,seconds,temperature,current_cost,best_cost,acceptance,moves_per_second");
+            for (const std::string& name : operators_) {
+                std::fprintf(file_, ",%s_proposed,%s_accepted,%s_improving,%s_new_best", name.c_str(), name.c_str(),
+                             name.c_str(), name.c_str());
+            }
+            std::fprintf(file_, "\n");
+        }
+    }
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    ~TraceWriter() {
+        if (file_) {
+            std::fclose(file_);
+        }
+    }
+
+    bool enabled() const { return file_ != nullptr; }
+    int sampleInterval() const { return sample_interval_; }
+    long flushInterval() const { return flush_interval_; }
+    int numOperators() const { return static_cast<int>(operators_.size()); }
+
+    // Routes an Annealer's telemetry into this trace as chain `chain`.
+    template <typename AnnealerOptions>
+    void configure(AnnealerOptions& options, int chain) {
+        if (enabled()) {
+            options.trace = this;
+            options.trace_chain = chain;
+        }
+    }
+
+    // `counters` holds numOperators() entries per sample.
+    void write(const std::vector<TraceSample>& samples, const std::vector<OperatorCounters>& counters) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t ops = operators_.size();
+        for (size_t i = 0; i < samples.size(); ++i) {
+            const TraceSample& s = samples[i];
+            const OperatorCounters* row = counters.data() + i * ops;
+            if (json_) {
+                std::fprintf(file_,
+                             "{\"chain\": %d, \"iteration\": %ld, \"seconds\": %.6f, \"temperature\": %.6g, "
+                             "\"current_cost\": %.6f, \"best_cost\": %.6f, \"acceptance\": %.4f, "
+                             "\"moves_per_second\": %.1f, \"operators\": {",
+                             s.chain, s.iteration, s.seconds, s.temperature, s.current_cost, s.best_cost, s.acceptance,
+                             s.moves_per_second);
+                for (size_t k = 0; k < ops; ++k) {
+                    std::fprintf(file_, "%s\"%s\": {\"proposed\": %ld, \"accepted\": %ld, \"improving\": %ld, \"new_best\": %ld}",
+                                 k ? ", " : "", operators_[k].c_str(), row[k].proposed, row[k].accepted, row[k].improving,
+                                 row[k].new_best);
+                }
+                std::fprintf(file_, "}}\n");
+            } else {
+                std::fprintf(file_, "%d,%ld,%.6f,%.6g,%.6f,%.6f,%.4f,%.1f", s.chain, s.iteration, s.seconds, s.temperature,
+                             s.current_cost, s.best_cost, s.acceptance, s.moves_per_second);
+                for (size_t k = 0; k < ops; ++k) {
+                    std::fprintf(file_, ",%ld,%ld,%ld,%ld", row[k].proposed, row[k].accepted, row[k].improving, row[k].new_best);
+                }
+                std::fprintf(file_, "\n");
+            }
+        }
+        std::fflush(file_);
+    }
+
+private:
+    static bool endsWith(const std::string& s, const std::string& suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    std::vector<std::string> operators_{"move"};
+    int sample_interval_ = 100;
+    long flush_interval_ = 10000;
+    std::FILE* file_ = nullptr;
+    bool json_ = false;
+    std::mutex mutex_;
+};
+
+// --trace FILE, --trace-interval N (iterations between samples, default 100) and
+// --trace-flush N (iterations between writes, default 10000), for the operators of Move.
+template <typename Move>
+TraceWriter traceFromArgs(int argc, char** argv) {
+    return TraceWriter(stringArg(argc, argv, "--trace", ""), MoveOperators<Move>::names(),
+                       intArg(argc, argv, "--trace-interval", 100), intArg(argc, argv, "--trace-flush", 10000));
+}
+
+#if VRP_TELEMETRY
+
+// Counts moves per operator as an Annealer makes them and, when given a trace, samples
+// the counters with the temperature and costs every sampleInterval() iterations into a
+// buffer sized for flushInterval() iterations, written out whenever it fills and on
+// destruction.
+template <typename Move>
+class SearchTelemetry {
+public:
+    SearchTelemetry() : counters_(MoveOperators<Move>::names().size()) {}
+    SearchTelemetry(SearchTelemetry&&) = default;
+    SearchTelemetry& operator=(SearchTelemetry&&) = default;
+    ~SearchTelemetry() { flush(); }
+
+    void attach(TraceWriter* trace, int chain) {
+        trace_ = trace;
+        chain_ = chain;
+        if (trace_) {
+            capacity_ = static_cast<size_t>(std::max(1L, trace_->flushInterval() / trace_->sampleInterval()));
+            samples_.reserve(capacity_);
+            sampled_counters_.reserve(capacity_ * counters_.size());
+        }
+    }
+
+    void proposed(const Move& move) { ++counters_[MoveOperators<Move>::of(move)].proposed; }
+    void accepted(const Move& move, bool improving) {
+        OperatorCounters& c = counters_[MoveOperators<Move>::of(move)];
+        ++c.accepted;
+        c.improving += improving;
+    }
+    void newBest(const Move& move) { ++counters_[MoveOperators<Move>::of(move)].new_best; }
+
+    // Called once per iteration, after the iteration's move.
+    void sample(long iteration, double temperature, double current_cost, double best_cost) {
+        if (!trace_) {
+            return;
+        }
+        if (!started_) {
+            started_ = true;
+            start_ = last_time_ = std::chrono::steady_clock::now();
+        }
+        if ((iteration + 1) % trace_->sampleInterval() != 0) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        long proposed = 0;
+        long accepted = 0;
+        for (const OperatorCounters& c : counters_) {
+            proposed += c.proposed;
+            accepted += c.accepted;
+        }
+        double interval = std::chrono::duration<double>(now - last_time_).count();
+        TraceSample s;
+        s.chain = chain_;
+        s.iteration = iteration + 1;
+        s.seconds = std::chrono::duration<double>(now - start_).count();
+        s.temperature = temperature;
+        s.current_cost = current_cost;
+        s.best_cost = best_cost;
+        s.acceptance = proposed > last_proposed_ ? static_cast<double>(accepted - last_accepted_) / (proposed - last_proposed_) : 0.0;
+        s.moves_per_second = interval > 0 ? (s.iteration - last_iteration_) / interval : 0.0;
+        samples_.push_back(s);
+        sampled_counters_.insert(sampled_counters_.end(), counters_.begin(), counters_.end());
+        last_proposed_ = proposed;
+        last_accepted_ = accepted;
+        last_iteration_ = s.iteration;
+        last_time_ = now;
+        if (samples_.size() >= capacity_) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (trace_ && !samples_.empty()) {
+            trace_->write(samples_, sampled_counters_);
+            samples_.clear();
+            sampled_counters_.clear();
+        }
+    }
+
+    const std::vector<OperatorCounters>& counters() const { return counters_; }
+
+private:
+    std::vector<OperatorCounters> counters_;
+    TraceWriter* trace_ = nullptr;
+    int chain_ = 0;
+    size_t capacity_ = 0;  // samples per flush
+    std::vector<TraceSample> samples_;
+    std::vector<OperatorCounters> sampled_counters_;
+    bool started_ = false;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point last_time_;
+    long last_proposed_ = 0;
+    long last_accepted_ = 0;
+    long last_iteration_ = 0;
+};
+
+#else
+
+// Built without VRP_TELEMETRY: every hook is empty and compiles away.
+template <typename Move>
+class SearchTelemetry {
+public:
+    void attach(TraceWriter*, int) {}
+    void proposed(const Move&) {}
+    void accepted(const Move&, bool) {}
+    void newBest(const Move&) {}
+    void sample(long, double, double, double) {}
+    void flush() {}
+};
+
+#endif
+
+}  // namespace vrp
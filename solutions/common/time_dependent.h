@@ -0,0 +1,67 @@
+// Time-dependent travel times from piecewise-constant speed profiles
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "distance_matrix.h"
+
+namespace vrp {
+
+// Ichoua, Gendreau & Potvin (2003) travel times. The day is cut into equal buckets and
+// each speed profile gives a speed factor per bucket; an arc stores only its distance and
+// a one-byte profile index. Travelling an arc means driving its distance through the
+// buckets at their speeds, so travel time is piecewise linear in the departure time and
+// FIFO: leaving later never arrives earlier. The last bucket's speed continues past the
+// end of the day.
+class TimeDependentTravel {
+public:
+    TimeDependentTravel() = default;
+
+    // profiles[p][b] is the speed of profile p during bucket b; every profile has the same
+    // number of buckets. All arcs start on profile 0.
+    TimeDependentTravel(DistanceMatrixF distances, double bucket_length, const std::vector<std::vector<double>>& profiles)
+        : distances_(std::move(distances)), bucket_length_(bucket_length),
+          num_buckets_(static_cast<int>(profiles[0].size())),
+          profile_of_(static_cast<size_t>(distances_.size()) * distances_.size(), 0) {
+        for (const std::vector<double>& profile : profiles) {
+            speeds_.insert(speeds_.end(), profile.begin(), profile.end());
+        }
+    }
+
+    int size() const { return distances_.size(); }
+    double distance(int i, int j) const { return distances_(i, j); }
+    void setProfile(int i, int j, int profile) { profile_of_[index(i, j)] = static_cast<uint8_t>(profile); }
+
+    double travelTime(int i, int j, double departure) const {
+        return arrival(i, j, departure) - departure;
+    }
+
+    double arrival(int i, int j, double departure) const {
+        double remaining = distances_(i, j);
+        const double* speeds = speeds_.data() + static_cast<size_t>(profile_of_[index(i, j)]) * num_buckets_;
+        double t = departure;
+        int bucket = t <= 0 ? 0 : static_cast<int>(t / bucket_length_);
+        for (; bucket < num_buckets_ - 1; ++bucket) {
+            double reach = speeds[bucket] * ((bucket + 1) * bucket_length_ - t);
+            if (reach >= remaining) {
+                return t + remaining / speeds[bucket];
+            }
+            remaining -= reach;
+            t = (bucket + 1) * bucket_length_;
+        }
+        return t + remaining / speeds[num_buckets_ - 1];
+    }
+
+private:
+    size_t index(int i, int j) const { return static_cast<size_t>(i) * distances_.size() + j; }
+
+    DistanceMatrixF distances_;
+    double bucket_length_ = 1.0;
+    int num_buckets_ = 1;
+    std::vector<uint8_t> profile_of_;
+    std::vector<double> speeds_;  // profile-major, num_buckets_ per profile
+};
+
+}  // namespace vrp
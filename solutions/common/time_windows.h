@@ -0,0 +1,85 @@
+// Time-window summaries of route segments for constant-time move evaluation
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace vrp {
+
+// Everything needed to join a run of consecutive stops to another in O(1) (the
+// concatenation of Vidal et al., 2013). earliest/latest bound the start of service at the
+// first stop such that the run incurs `time_warp` (lateness that had to be forgiven) and
+// no extra waiting. duration counts travel, service and waiting.
+struct TimeWindowSegment {
+    int first, last;        // node ids at either end
+    double duration;
+    double time_warp;
+    double earliest, latest;
+    double distance;
+    double service;
+    int load;
+
+    static TimeWindowSegment node(int id, double ready, double due, double service_time, int demand) {
+        return {id, id, service_time, 0.0, ready, due, 0.0, service_time, demand};
+    }
+
+    double waiting() const { return duration - distance - service; }
+};
+
+// a followed by b, where travel is the time (and distance) from a.last to b.first.
+inline TimeWindowSegment concat(const TimeWindowSegment& a, const TimeWindowSegment& b, double travel) {
+    double shift = a.duration - a.time_warp + travel;
+    double wait = std::max(b.earliest - shift - a.latest, 0.0);
+    double warp = std::max(a.earliest + shift - b.latest, 0.0);
+    TimeWindowSegment s;
+    s.first = a.first;
+    s.last = b.last;
+    s.duration = a.duration + b.duration + travel + wait;
+    s.time_warp = a.time_warp + b.time_warp + warp;
+    s.earliest = std::max(b.earliest - shift, a.earliest) - wait;
+    s.latest = std::min(b.latest - shift, a.latest) + warp;
+    s.distance = a.distance + b.distance + travel;
+    s.service = a.service + b.service;
+    s.load = a.load + b.load;
+    return s;
+}
+
+// Prefix and suffix segments of one route depot -> route[0..m-1] -> depot:
+// forward[k] covers the start depot and the first k customers, backward[k] covers
+// customers k..m-1 and the return to the depot. Any route built by cutting this one and
+// splicing in other segments is then priced by two or three concat() calls.
+struct RouteSegments {
+    std::vector<TimeWindowSegment> forward;
+    std::vector<TimeWindowSegment> backward;
+
+    const TimeWindowSegment& whole() const { return forward.back(); }
+
+    // Recomputes forward[k] for k > from and backward[k] for k <= to. A change at route
+    // position i invalidates forward entries after i and backward entries up to i.
+    template <typename NodeSegment, typename Travel>
+    void update(const std::vector<int>& route, const TimeWindowSegment& depot, NodeSegment nodeSegment, Travel travel,
+                int from, int to) {
+        int m = static_cast<int>(route.size());
+        forward.resize(m + 2);
+        backward.resize(m + 1);
+        forward[0] = depot;
+        for (int k = std::max(from, 0) + 1; k <= m; ++k) {
+            const TimeWindowSegment& prev = forward[k - 1];
+            forward[k] = concat(prev, nodeSegment(route[k - 1]), travel(prev.last, route[k - 1]));
+        }
+        // forward[m + 1] closes the route at the depot; whole() returns it.
+        forward[m + 1] = concat(forward[m], depot, travel(forward[m].last, depot.first));
+        backward[m] = depot;
+        for (int k = std::min(to, m - 1); k >= 0; --k) {
+            TimeWindowSegment stop = nodeSegment(route[k]);
+            backward[k] = concat(stop, backward[k + 1], travel(route[k], backward[k + 1].first));
+        }
+    }
+
+    template <typename NodeSegment, typename Travel>
+    void rebuild(const std::vector<int>& route, const TimeWindowSegment& depot, NodeSegment nodeSegment, Travel travel) {
+        update(route, depot, nodeSegment, travel, 0, static_cast<int>(route.size()));
+    }
+};
+
+}  // namespace vrp
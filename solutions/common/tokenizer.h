@@ -0,0 +1,161 @@
+// Memory-mapped input files and a non-allocating whitespace tokenizer for the instance readers
+#pragma once
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace vrp {
+
+// Read-only mapping of a whole file; the bytes stay valid for the object's lifetime. Errors
+// are thrown as std::runtime_error without the path, which callers add.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("unable to open: ") + std::strerror(errno));
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error(std::string("unable to stat: ") + std::strerror(error));
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ > 0) {
+            void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw std::runtime_error(std::string("unable to map: ") + std::strerror(error));
+            }
+            ::madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(data);
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+    ~MappedFile() {
+        if (data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view text() const { return std::string_view(data_, size_); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Splits a character range into whitespace-separated tokens without copying. Tokens are
+// views into the range, and numbers are parsed in place with std::from_chars, so the
+// range needs no terminating NUL.
+class Tokenizer {
+public:
+    explicit Tokenizer(std::string_view text) : pos_(text.data()), end_(text.data() + text.size()) {}
+
+    bool atEnd() {
+        skipSpace();
+        return pos_ == end_;
+    }
+
+    // Next token, or an empty view at the end of the input.
+    std::string_view next() {
+        skipSpace();
+        const char* begin = pos_;
+        while (pos_ != end_ && !isSpace(*pos_)) {
+            ++pos_;
+        }
+        return std::string_view(begin, pos_ - begin);
+    }
+
+    // The rest of the current line with surrounding blanks removed; moves past its newline.
+    std::string_view line() {
+        const char* begin = pos_;
+        while (pos_ != end_ && *pos_ != '\n') {
+            ++pos_;
+        }
+        std::string_view result = trim(std::string_view(begin, pos_ - begin));
+        if (pos_ != end_) {
+            ++pos_;
+        }
+        return result;
+    }
+
+    // Skips blank lines and returns the next non-blank one.
+    std::string_view nextLine() {
+        std::string_view result;
+        while (result.empty() && pos_ != end_) {
+            result = line();
+        }
+        return result;
+    }
+
+    template <typename T>
+    bool next(T& value) {
+        std::string_view token = next();
+        return !token.empty() && parse(token, value);
+    }
+
+    // Reads a number the caller knows must be there.
+    template <typename T>
+    T expect(const char* what) {
+        T value;
+        if (!next(value)) {
+            throw std::runtime_error(std::string("expected ") + what);
+        }
+        return value;
+    }
+
+    template <typename T>
+    static bool parse(std::string_view token, T& value) {
+        const char* begin = token.data();
+        if (!token.empty() && *begin == '+') {
+            ++begin;
+        }
+        std::from_chars_result result = std::from_chars(begin, token.data() + token.size(), value);
+        return result.ec == std::errc() && result.ptr == token.data() + token.size();
+    }
+
+    static std::string_view trim(std::string_view s) {
+        while (!s.empty() && isSpace(s.front())) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && isSpace(s.back())) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+private:
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v'; }
+
+    void skipSpace() {
+        while (pos_ != end_ && isSpace(*pos_)) {
+            ++pos_;
+        }
+    }
+
+    const char* pos_;
+    const char* end_;
+};
+
+}  // namespace vrp
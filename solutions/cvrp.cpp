@@ -2,10 +2,19 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include <cstdlib>
-#include <ctime>
 #include <algorithm>
 #include <limits>
+#include "common/adaptive_schedule.h"
+#include "common/annealer.h"
+#include "common/anytime.h"
+#include "common/cli.h"
+#include "common/distance_matrix.h"
+#include "common/instances.h"
+#include "common/neighbor_lists.h"
+#include "common/operator_weights.h"
+#include "common/parallel_annealing.h"
+#include "common/report.h"
+#include "common/rng.h"
 
 using namespace std;
 
@@ -13,137 +22,636 @@ const int NUM_CUSTOMERS = 20;
 const int NUM_VEHICLES = 5;
 const int CAPACITY = 100;
 const int MAX_ITERATIONS = 10000;
-const double INIT_TEMPERATURE = 1000.0;
-const double COOLING_RATE = 0.003;
+const double INIT_TEMPERATURE = 1000.0;  // replaced by calibration when a sampled move goes uphill
+const int DRIFT_CHECK_INTERVAL = 1000;
+const int NEIGHBOR_LIST_SIZE = 10;
+const int MAX_SEGMENT = 3;              // longest segment an Or-opt or CROSS move carries
+const int PROPOSE_ATTEMPTS = 8;         // draws per iteration before giving up on a move
+const double REWARD_NEW_BEST = 5.0;     // operator rewards for the adaptive weights
+const double REWARD_IMPROVING = 2.0;
+const double REWARD_ACCEPTED = 1.0;
+const int PENALTY_WINDOW = 1000;       // proposals between adjustments of an adaptive capacity penalty
+const double TARGET_FEASIBLE_SHARE = 0.5;
+const double PENALTY_FACTOR = 1.1;      // adjustment per window
+
+// Problem size; the defaults above unless an instance file is loaded.
+int num_customers = NUM_CUSTOMERS;
+int num_vehicles = NUM_VEHICLES;
+int depot_node = NUM_CUSTOMERS;  // depot row/column in the distance matrix, after the customers
+int capacity = CAPACITY;
 
 struct Customer {
     int demand;
-    int x, y;
+    double x, y;
 };
 
-double distance(const Customer& cust1, const Customer& cust2) {
-    return sqrt(pow(cust1.x - cust2.x, 2) + pow(cust1.y - cust2.y, 2));
-}
-
-void generateProblem(vector<Customer>& customers, int& depot_x, int& depot_y) {
-    srand(time(NULL));
-    
-    depot_x = rand() % 100;
-    depot_y = rand() % 100;
+void generateProblem(vector<Customer>& customers, int& depot_x, int& depot_y, vrp::Rng& rng) {
+    depot_x = rng.uniformInt(100);
+    depot_y = rng.uniformInt(100);
     
     for (int i = 0; i < NUM_CUSTOMERS; ++i) {
         Customer cust;
-        cust.demand = rand() % 10 + 1;
-        cust.x = rand() % 100;
-        cust.y = rand() % 100;
+        cust.demand = rng.uniformInt(10) + 1;
+        cust.x = rng.uniformInt(100);
+        cust.y = rng.uniformInt(100);
         customers.push_back(cust);
     }
 }
 
-double calculateTotalDistance(const vector<vector<int>>& routes, const vector<Customer>& customers, const Customer& depot) {
+vrp::DistanceMatrix buildDistanceMatrix(const vector<Customer>& customers, const Customer& depot) {
+    vector<Customer> nodes = customers;
+    nodes.push_back(depot);
+    return vrp::DistanceMatrix::euclidean(nodes);
+}
+
+// CVRPLIB numbers the depot first; here it moves behind the customers. The fleet is the
+// "-kN" of the instance name, or the fewest vehicles the total demand allows.
+vrp::DistanceMatrix loadProblem(const vrp::CvrpInstance& instance, vector<Customer>& customers) {
+    int total_demand = 0;
+    for (int i = 1; i < instance.nodes.size(); ++i) {
+        customers.push_back({instance.nodes[i].demand, instance.nodes[i].x, instance.nodes[i].y});
+        total_demand += instance.nodes[i].demand;
+    }
+    num_customers = customers.size();
+    depot_node = num_customers;
+    num_vehicles = instance.vehicles;
+    if (instance.capacity > 0) {
+        capacity = instance.capacity;
+    }
+    if (num_vehicles == 0) {
+        num_vehicles = instance.capacity > 0 ? (total_demand + instance.capacity - 1) / instance.capacity : 1;
+    }
+
+    int n = instance.nodes.size();
+    return vrp::DistanceMatrix::build(n, [&instance, n](int i, int j) {
+        return instance.distance((i + 1) % n, (j + 1) % n);
+    });
+}
+
+double calculateTotalDistance(const vector<vector<int>>& routes, const vrp::DistanceMatrix& dist) {
     double total_distance = 0.0;
     
     for (const auto& route : routes) {
         if (route.empty()) continue;
         
-        total_distance += distance(depot, customers[route[0]]);
+        total_distance += dist(depot_node, route[0]);
         
         for (int i = 0; i < route.size() - 1; ++i) {
-            total_distance += distance(customers[route[i]], customers[route[i + 1]]);
+            total_distance += dist(route[i], route[i + 1]);
         }
         
-        total_distance += distance(customers[route.back()], depot);
+        total_distance += dist(route.back(), depot_node);
     }
     
     return total_distance;
 }
 
-vector<vector<int>> generateInitialSolution(const vector<Customer>& customers) {
-    vector<vector<int>> solution(NUM_VEHICLES);
-    vector<int> customer_indices(NUM_CUSTOMERS);
+int routeDemand(const vector<int>& route, const vector<Customer>& customers) {
+    int load = 0;
+    for (int c : route) {
+        load += customers[c].demand;
+    }
+    return load;
+}
+
+// Customers in random order, each on the first vehicle from a random one onwards that
+// still has room, or on the least loaded if none has.
+vector<vector<int>> generateInitialSolution(const vector<Customer>& customers, vrp::Rng& rng) {
+    vector<vector<int>> solution(num_vehicles);
+    vector<int> loads(num_vehicles, 0);
+    vector<int> customer_indices(num_customers);
     
-    for (int i = 0; i < NUM_CUSTOMERS; ++i) {
+    for (int i = 0; i < num_customers; ++i) {
         customer_indices[i] = i;
     }
     
-    random_shuffle(customer_indices.begin(), customer_indices.end());
+    shuffle(customer_indices.begin(), customer_indices.end(), rng);
     
-    int vehicle_index = 0;
-    for (int i = 0; i < NUM_CUSTOMERS; ++i) {
-        if (i % (NUM_CUSTOMERS / NUM_VEHICLES) == 0 && vehicle_index < NUM_VEHICLES) {
-            ++vehicle_index;
+    for (int c : customer_indices) {
+        int demand = customers[c].demand;
+        int vehicle = min_element(loads.begin(), loads.end()) - loads.begin();
+        int first = rng.uniformInt(num_vehicles);
+        for (int k = 0; k < num_vehicles; ++k) {
+            int v = (first + k) % num_vehicles;
+            if (loads[v] + demand <= capacity) {
+                vehicle = v;
+                break;
+            }
         }
-        solution[vehicle_index - 1].push_back(customer_indices[i]);
+        solution[vehicle].push_back(c);
+        loads[vehicle] += demand;
     }
     
     return solution;
 }
 
-vector<vector<int>> generateNeighborSolution(const vector<vector<int>>& current_solution) {
-    vector<vector<int>> neighbor_solution = current_solution;
-    
-    int route1 = rand() % NUM_VEHICLES;
-    int route2 = rand() % NUM_VEHICLES;
-    
-    if (neighbor_solution[route1].empty() || neighbor_solution[route2].empty()) {
-        return neighbor_solution;
+// Position -1 and route.size() both stand for the depot at either end of the route.
+int stopAt(const vector<int>& route, int index) {
+    if (index < 0 || index >= (int)route.size()) {
+        return depot_node;
     }
-    
-    int cust_index1 = rand() % neighbor_solution[route1].size();
-    int cust_index2 = rand() % neighbor_solution[route2].size();
-    
-    int temp = neighbor_solution[route1][cust_index1];
-    neighbor_solution[route1][cust_index1] = neighbor_solution[route2][cust_index2];
-    neighbor_solution[route2][cust_index2] = temp;
-    
-    return neighbor_solution;
+    return route[index];
 }
 
-double evaluateSolution(const vector<vector<int>>& solution, const vector<Customer>& customers, const Customer& depot) {
-    double total_distance = calculateTotalDistance(solution, customers, depot);
-    return total_distance;
+// Every operator joins a customer to one of its nearest neighbours, so each move creates
+// one short arc:
+//   SWAP          exchanges route1[index1] and route2[index2]
+//   RELOCATE      moves route1[index1] before position index2 of route2
+//   TWO_OPT       reverses route1[index1..index2]
+//   TWO_OPT_STAR  exchanges the tails route1[index1..] and route2[index2..]
+//   OR_OPT        moves route1[index1, index1 + length1) before position index2 of route2,
+//                 reversed if `reversed`
+//   CROSS         exchanges route1[index1, index1 + length1) and route2[index2, index2 + length2)
+// TWO_OPT stays inside one route, TWO_OPT_STAR and CROSS join two; the others do either.
+// Positions are those before the move. CvrpProblem prices each move from the arcs it
+// removes and adds and checks it against prefix loads, both in O(1); distances are
+// symmetric, so a reversed segment costs the same inside.
+struct CvrpMove {
+    static constexpr const char* kOperators[] = {"swap", "relocate", "two_opt", "two_opt_star", "or_opt", "cross"};  // for telemetry, by kind
+    int operatorIndex() const { return kind; }
+
+    enum Kind { SWAP, RELOCATE, TWO_OPT, TWO_OPT_STAR, OR_OPT, CROSS } kind;
+    int route1, index1, length1;
+    int route2, index2, length2;
+    bool reversed;
+    int load1, load2;       // route loads after the move
+    double distance_delta;
+    int excess_delta;       // change in total load over capacity
+    double delta;
+};
+
+// How routes over capacity are priced. By default no move may overload a route further,
+// and `weight` per unit of excess load only steers an overloaded start back to
+// feasibility. When `adaptive`, any move is allowed and the weight is raised or lowered
+// every PENALTY_WINDOW proposals by whether fewer or more than TARGET_FEASIBLE_SHARE of
+// them started from a feasible solution, so the search runs along the feasible boundary.
+struct CapacityPenalty {
+    double weight;
+    bool adaptive;
+};
+
+int excessLoad(int load) {
+    return max(0, load - capacity);
 }
 
-bool acceptNeighbor(double current_cost, double new_cost, double temperature) {
-    if (new_cost < current_cost) {
-        return true;
+// A unit of excess load costs about a round trip to the depot for one average customer's
+// demand.
+double initialPenaltyWeight(const vector<Customer>& customers, const vrp::DistanceMatrix& dist) {
+    double depot_distance = 0.0;
+    double demand = 0.0;
+    for (int c = 0; c < num_customers; ++c) {
+        depot_distance += dist(depot_node, c);
+        demand += customers[c].demand;
     }
-    double acceptance_prob = exp((current_cost - new_cost) / temperature);
-    double random_prob = static_cast<double>(rand()) / RAND_MAX;
-    return random_prob < acceptance_prob;
+    return demand > 0 ? 2.0 * depot_distance / demand : 1.0;
 }
 
-void updateTemperature(double& temperature) {
-    temperature *= (1 - COOLING_RATE);
+double evaluateSolution(const vector<vector<int>>& solution, const vrp::DistanceMatrix& dist) {
+    double total_distance = calculateTotalDistance(solution, dist);
+    return total_distance;
 }
 
-int main() {
-    vector<Customer> customers;
-    int depot_x, depot_y;
-    generateProblem(customers, depot_x, depot_y);
+// Current routes with the position index the granular move generator needs and prefix
+// loads for the capacity checks. Operators are drawn by OperatorWeights, rewarded on
+// commit by how much their move helped. The cost is the distance plus the capacity
+// penalty; a move's new loads come from the prefix loads and are checked in O(1) before
+// it is priced. Moves are priced by arc delta and only applied on commit. Because the
+// cost of an infeasible solution depends on the penalty weight, the shortest feasible
+// solution met is kept apart from the annealer's best.
+struct CvrpProblem {
+    using Solution = vector<vector<int>>;
     
-    double temperature = INIT_TEMPERATURE;
-    vector<vector<int>> current_solution = generateInitialSolution(customers);
-    double current_cost = evaluateSolution(current_solution, customers, {0, depot_x, depot_y});
+    const vrp::DistanceMatrix* dist;
+    const vrp::NeighborLists* neighbors;
+    const vector<Customer>* customers;
+    Solution routes;
+    vrp::RoutePositions positions;
+    vector<vector<int>> prefix_load;  // prefix_load[r][i]: demand of the first i customers of route r
+    vrp::OperatorWeights weights;
+    CapacityPenalty penalty;
+    double distance;
+    int excess;                       // total load over capacity
+    double total_cost;
+    double best_cost = numeric_limits<double>::infinity();  // for rewards
+    Solution best_feasible;
+    double best_feasible_distance = numeric_limits<double>::infinity();
+    double best_feasible_time = 0.0;  // seconds from construction
+    vrp::Stopwatch stopwatch;
+    double initial_penalty;           // bounds an adaptive weight to three orders of magnitude either way
+    int window_proposals = 0;
+    int window_feasible = 0;
     
-    vector<vector<int>> best_solution = current_solution;
-    double best_cost = current_cost;
+    CvrpProblem(const vrp::DistanceMatrix& dist, const vrp::NeighborLists& neighbors, const vector<Customer>& customers,
+                vrp::OperatorWeights weights, CapacityPenalty penalty, const Solution& initial)
+        : dist(&dist), neighbors(&neighbors), customers(&customers), weights(move(weights)), penalty(penalty),
+          initial_penalty(penalty.weight) {
+        load(initial);
+    }
     
-    for (int iter = 0; iter < MAX_ITERATIONS; ++iter) {
-        vector<vector<int>> neighbor_solution = generateNeighborSolution(current_solution);
-        double neighbor_cost = evaluateSolution(neighbor_solution, customers, {0, depot_x, depot_y});
-        
-        if (acceptNeighbor(current_cost, neighbor_cost, temperature)) {
-            current_solution = neighbor_solution;
-            current_cost = neighbor_cost;
+    double cost() const { return total_cost; }
+    const Solution& solution() const { return routes; }
+    
+    void load(const Solution& solution) {
+        routes = solution;
+        positions.rebuild(routes, num_customers);
+        prefix_load.resize(routes.size());
+        for (int r = 0; r < routes.size(); ++r) {
+            refreshLoads(r);
         }
-        
-        if (current_cost < best_cost) {
-            best_solution = current_solution;
-            best_cost = current_cost;
+        resync();
+        best_cost = min(best_cost, total_cost);
+        recordFeasible();
+    }
+    
+    bool propose(CvrpMove& move, vrp::Rng& rng) {
+        if (penalty.adaptive) {
+            adaptPenalty();
+        }
+        for (int attempt = 0; attempt < PROPOSE_ATTEMPTS; ++attempt) {
+            if (draw(move, rng) && fits(move)) {
+                weights.used(move.kind);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    double evaluate(CvrpMove& move) {
+        move.distance_delta = price(move);
+        move.excess_delta = 0;
+        if (move.route1 != move.route2) {
+            move.excess_delta = excessLoad(move.load1) + excessLoad(move.load2)
+                                - excessLoad(routeLoad(move.route1)) - excessLoad(routeLoad(move.route2));
+        }
+        move.delta = move.distance_delta + penalty.weight * move.excess_delta;
+        return move.delta;
+    }
+    
+    void commit(CvrpMove& move) {
+        apply(move);
+        distance += move.distance_delta;
+        excess += move.excess_delta;
+        total_cost = distance + penalty.weight * excess;
+        recordFeasible();
+        if (total_cost < best_cost) {
+            best_cost = total_cost;
+            weights.reward(move.kind, REWARD_NEW_BEST);
+        } else {
+            weights.reward(move.kind, move.delta < 0 ? REWARD_IMPROVING : REWARD_ACCEPTED);
+        }
+    }
+    
+    void revert(CvrpMove&) {}
+    
+    // Accumulated deltas drift from the true cost by rounding; the annealer calls this periodically.
+    void resync() {
+        distance = evaluateSolution(routes, *dist);
+        excess = 0;
+        for (int r = 0; r < routes.size(); ++r) {
+            excess += excessLoad(routeLoad(r));
+        }
+        total_cost = distance + penalty.weight * excess;
+    }
+    
+private:
+    void recordFeasible() {
+        if (excess == 0 && distance < best_feasible_distance) {
+            best_feasible = routes;
+            best_feasible_distance = distance;
+            best_feasible_time = stopwatch.seconds();
         }
-        
-        updateTemperature(temperature);
+    }
+    
+    void adaptPenalty() {
+        window_feasible += excess == 0;
+        if (++window_proposals < PENALTY_WINDOW) {
+            return;
+        }
+        bool too_infeasible = window_feasible < TARGET_FEASIBLE_SHARE * window_proposals;
+        penalty.weight *= too_infeasible ? PENALTY_FACTOR : 1.0 / PENALTY_FACTOR;
+        penalty.weight = min(max(penalty.weight, initial_penalty * 1e-3), initial_penalty * 1e3);
+        total_cost = distance + penalty.weight * excess;
+        window_proposals = window_feasible = 0;
+    }
+
+    int routeLoad(int r) const { return prefix_load[r].back(); }
+    int segmentLoad(int r, int begin, int end) const { return prefix_load[r][end] - prefix_load[r][begin]; }
+    int length(int r) const { return routes[r].size(); }
+    
+    void refreshLoads(int r) {
+        prefix_load[r].resize(routes[r].size() + 1);
+        prefix_load[r][0] = 0;
+        for (int i = 0; i < routes[r].size(); ++i) {
+            prefix_load[r][i + 1] = prefix_load[r][i] + (*customers)[routes[r][i]].demand;
+        }
+    }
+    
+    void refreshRoute(int r) {
+        for (int i = 0; i < routes[r].size(); ++i) {
+            positions.place(routes[r][i], r, i);
+        }
+        refreshLoads(r);
+    }
+    
+    // Picks a customer and a neighbour and fits the drawn operator around them, or returns
+    // false if it does not apply to the pair. One relocation in NEIGHBOR_LIST_SIZE goes to
+    // a random route instead, so that empty routes can be used again.
+    bool draw(CvrpMove& move, vrp::Rng& rng) const {
+        if (neighbors->k() == 0) {
+            return false;
+        }
+        int a = rng.uniformInt(num_customers);
+        int b = neighbors->of(a)[rng.uniformInt(neighbors->k())];
+        int ra = positions.route[a];
+        int ia = positions.index[a];
+        int rb = positions.route[b];
+        int ib = positions.index[b];
+        move.kind = static_cast<CvrpMove::Kind>(weights.sample(rng));
+        move.route1 = ra;
+        move.index1 = ia;
+        move.route2 = rb;
+        move.index2 = ib;
+        move.length1 = move.length2 = 1;
+        move.reversed = false;
+        switch (move.kind) {
+        case CvrpMove::SWAP:
+            return true;
+        case CvrpMove::RELOCATE:
+            if (rng.uniformInt(NEIGHBOR_LIST_SIZE) == 0) {
+                move.route2 = rng.uniformInt(num_vehicles);
+                move.index2 = rng.uniformInt(length(move.route2) + 1);
+            } else {
+                move.index2 = ib + rng.uniformInt(2);  // before or after b
+            }
+            return move.route2 != ra || (move.index2 != ia && move.index2 != ia + 1);
+        case CvrpMove::TWO_OPT:
+            if (ra != rb) {
+                return false;
+            }
+            move.index1 = ia < ib ? ia + 1 : ib;
+            move.index2 = ia < ib ? ib : ia - 1;
+            return move.index1 < move.index2;
+        case CvrpMove::TWO_OPT_STAR:
+            move.index1 = ia + 1;
+            return ra != rb;
+        case CvrpMove::OR_OPT:
+            move.length1 = min(2 + rng.uniformInt(MAX_SEGMENT - 1), length(ra) - ia);
+            move.reversed = rng.uniformInt(2) == 1;
+            move.index2 = ib + 1;  // after b
+            return move.length1 >= 2 && (ra != rb || ib < ia - 1 || ib >= ia + move.length1);
+        case CvrpMove::CROSS:
+            move.index1 = ia + 1;
+            move.length1 = min(1 + rng.uniformInt(MAX_SEGMENT), length(ra) - move.index1);
+            move.length2 = min(1 + rng.uniformInt(MAX_SEGMENT), length(rb) - ib);
+            return ra != rb && move.length1 > 0;
+        }
+        return false;
+    }
+    
+    // Sets the move's new route loads. Unless the penalty is adaptive, a route's load may
+    // grow past capacity only if it was already above its new value.
+    bool fits(CvrpMove& move) const {
+        int r1 = move.route1;
+        int r2 = move.route2;
+        if (r1 == r2) {
+            return true;
+        }
+        int moved1 = 0;  // leaves route1 for route2
+        int moved2 = 0;  // leaves route2 for route1
+        switch (move.kind) {
+        case CvrpMove::SWAP:
+        case CvrpMove::CROSS:
+            moved1 = segmentLoad(r1, move.index1, move.index1 + move.length1);
+            moved2 = segmentLoad(r2, move.index2, move.index2 + move.length2);
+            break;
+        case CvrpMove::RELOCATE:
+        case CvrpMove::OR_OPT:
+            moved1 = segmentLoad(r1, move.index1, move.index1 + move.length1);
+            break;
+        case CvrpMove::TWO_OPT_STAR:
+            moved1 = segmentLoad(r1, move.index1, length(r1));
+            moved2 = segmentLoad(r2, move.index2, length(r2));
+            break;
+        case CvrpMove::TWO_OPT:
+            return true;
+        }
+        move.load1 = routeLoad(r1) - moved1 + moved2;
+        move.load2 = routeLoad(r2) - moved2 + moved1;
+        return penalty.adaptive
+               || ((move.load1 <= capacity || moved2 <= moved1) && (move.load2 <= capacity || moved1 <= moved2));
+    }
+    
+    double price(const CvrpMove& move) const {
+        const vrp::DistanceMatrix& d = *dist;
+        const vector<int>& r1 = routes[move.route1];
+        const vector<int>& r2 = routes[move.route2];
+        int i = move.index1;
+        int j = move.index2;
+        switch (move.kind) {
+        case CvrpMove::SWAP:
+            if (move.route1 == move.route2) {
+                if (i > j) {
+                    swap(i, j);
+                }
+                if (j == i + 1) {
+                    int prev = stopAt(r1, i - 1);
+                    int next = stopAt(r1, j + 1);
+                    return d(prev, r1[j]) + d(r1[i], next) - d(prev, r1[i]) - d(r1[j], next);
+                }
+                int a = r1[i];
+                int b = r1[j];
+                return d(stopAt(r1, i - 1), b) + d(b, stopAt(r1, i + 1)) + d(stopAt(r1, j - 1), a) + d(a, stopAt(r1, j + 1))
+                       - d(stopAt(r1, i - 1), a) - d(a, stopAt(r1, i + 1)) - d(stopAt(r1, j - 1), b) - d(b, stopAt(r1, j + 1));
+            }
+            [[fallthrough]];
+        case CvrpMove::CROSS: {
+            int first1 = r1[i];
+            int last1 = r1[i + move.length1 - 1];
+            int first2 = r2[j];
+            int last2 = r2[j + move.length2 - 1];
+            int prev1 = stopAt(r1, i - 1);
+            int next1 = stopAt(r1, i + move.length1);
+            int prev2 = stopAt(r2, j - 1);
+            int next2 = stopAt(r2, j + move.length2);
+            return d(prev1, first2) + d(last2, next1) + d(prev2, first1) + d(last1, next2)
+                   - d(prev1, first1) - d(last1, next1) - d(prev2, first2) - d(last2, next2);
+        }
+        case CvrpMove::RELOCATE:
+        case CvrpMove::OR_OPT: {
+            int first = r1[i];
+            int last = r1[i + move.length1 - 1];
+            int prev = stopAt(r1, i - 1);
+            int next = stopAt(r1, i + move.length1);
+            int before = stopAt(r2, j - 1);
+            int after = stopAt(r2, j);
+            if (move.reversed) {
+                swap(first, last);
+            }
+            return d(prev, next) - d(prev, r1[i]) - d(r1[i + move.length1 - 1], next)
+                   + d(before, first) + d(last, after) - d(before, after);
+        }
+        case CvrpMove::TWO_OPT: {
+            int prev = stopAt(r1, i - 1);
+            int next = stopAt(r1, j + 1);
+            return d(prev, r1[j]) + d(r1[i], next) - d(prev, r1[i]) - d(r1[j], next);
+        }
+        case CvrpMove::TWO_OPT_STAR: {
+            int end1 = stopAt(r1, i - 1);
+            int start1 = stopAt(r1, i);
+            int end2 = stopAt(r2, j - 1);
+            int start2 = stopAt(r2, j);
+            return d(end1, start2) + d(end2, start1) - d(end1, start1) - d(end2, start2);
+        }
+        }
+        return 0.0;
+    }
+    
+    void apply(const CvrpMove& move) {
+        vector<int>& r1 = routes[move.route1];
+        vector<int>& r2 = routes[move.route2];
+        int i = move.index1;
+        int j = move.index2;
+        switch (move.kind) {
+        case CvrpMove::SWAP:
+            swap(r1[i], r2[j]);
+            break;
+        case CvrpMove::TWO_OPT:
+            reverse(r1.begin() + i, r1.begin() + j + 1);
+            break;
+        case CvrpMove::RELOCATE:
+        case CvrpMove::OR_OPT: {
+            int length = move.length1;
+            if (move.route1 == move.route2) {
+                if (j > i) {
+                    rotate(r1.begin() + i, r1.begin() + i + length, r1.begin() + j);
+                    j -= length;
+                } else {
+                    rotate(r1.begin() + j, r1.begin() + i, r1.begin() + i + length);
+                }
+            } else {
+                r2.insert(r2.begin() + j, r1.begin() + i, r1.begin() + i + length);
+                r1.erase(r1.begin() + i, r1.begin() + i + length);
+            }
+            if (move.reversed) {
+                reverse(r2.begin() + j, r2.begin() + j + length);
+            }
+            break;
+        }
+        case CvrpMove::TWO_OPT_STAR: {
+            // Both tails are appended to the other route before the old ones are cut off.
+            int length1 = r1.size();
+            int length2 = r2.size();
+            r1.insert(r1.end(), r2.begin() + j, r2.end());
+            r2.insert(r2.end(), r1.begin() + i, r1.begin() + length1);
+            r1.erase(r1.begin() + i, r1.begin() + length1);
+            r2.erase(r2.begin() + j, r2.begin() + length2);
+            break;
+        }
+        case CvrpMove::CROSS: {
+            // The common length is swapped in place; what is left of the longer segment moves across.
+            int common = min(move.length1, move.length2);
+            swap_ranges(r1.begin() + i, r1.begin() + i + common, r2.begin() + j);
+            if (move.length1 > common) {
+                r2.insert(r2.begin() + j + common, r1.begin() + i + common, r1.begin() + i + move.length1);
+                r1.erase(r1.begin() + i + common, r1.begin() + i + move.length1);
+            } else if (move.length2 > common) {
+                r1.insert(r1.begin() + i + common, r2.begin() + j + common, r2.begin() + j + move.length2);
+                r2.erase(r2.begin() + j + common, r2.begin() + j + move.length2);
+            }
+            break;
+        }
+        }
+        refreshRoute(move.route1);
+        if (move.route2 != move.route1) {
+            refreshRoute(move.route2);
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    vrp::ParallelOptions parallel = vrp::parallelOptionsFromArgs(argc, argv, 1000);
+    uint64_t seed = vrp::seedArg(argc, argv, vrp::timeSeed());
+    vrp::Rng rng(seed);
+    string instance_path = vrp::stringArg(argc, argv, "--instance", "");
+    vrp::AnytimeOptions anytime = vrp::anytimeOptionsFromArgs(argc, argv);
+    bool json = vrp::hasFlag(argc, argv, "--json");
+    
+    vector<Customer> customers;
+    vrp::DistanceMatrix dist;
+    string instance_name = "random";
+    if (!instance_path.empty()) {
+        try {
+            vrp::CvrpInstance instance = vrp::loadCvrplib(instance_path);
+            instance_name = instance.name;
+            dist = loadProblem(instance, customers);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    } else {
+        int depot_x, depot_y;
+        generateProblem(customers, depot_x, depot_y, rng);
+        Customer depot = {0, (double)depot_x, (double)depot_y};
+        dist = buildDistanceMatrix(customers, depot);
+    }
+    vrp::NeighborLists neighbors = vrp::NeighborLists::build(customers, NEIGHBOR_LIST_SIZE);
+    
+    // A time limit replaces the iteration budget, and the schedule cools over whichever applies.
+    long iterations = anytime.iterationBudget(MAX_ITERATIONS);
+    using Annealer = vrp::Annealer<CvrpProblem, CvrpMove, vrp::AdaptiveSchedule>;
+    Annealer::Options options;
+    options.resync_interval = DRIFT_CHECK_INTERVAL;
+    vrp::ProgressStream progress;
+    anytime.configure(options, progress);
+    vrp::TraceWriter trace = vrp::traceFromArgs<CvrpMove>(argc, argv);
+    vrp::OperatorWeights weights = vrp::operatorWeightsFromArgs(argc, argv, size(CvrpMove::kOperators));
+    CapacityPenalty penalty = {initialPenaltyWeight(customers, dist), vrp::hasFlag(argc, argv, "--capacity-penalty")};
+    vrp::AdaptiveScheduleOptions schedule = vrp::AdaptiveScheduleOptions::budget(MAX_ITERATIONS, anytime.deadline.remaining());
+    vector<Annealer> chains;
+    for (int i = 0; i < parallel.num_chains; ++i) {
+        vrp::Rng chain_rng = rng.split();
+        CvrpProblem problem(dist, neighbors, customers, weights, penalty, generateInitialSolution(customers, chain_rng));
+        trace.configure(options, i);
+        chains.emplace_back(problem, vrp::AdaptiveSchedule(INIT_TEMPERATURE, schedule), chain_rng, options);
+        chains.back().calibrateTemperature(schedule.initial_acceptance);
+    }
+    vrp::Stopwatch stopwatch;
+    int best_chain = vrp::runChains(chains, iterations, parallel, rng);
+    double elapsed = stopwatch.seconds();
+    
+    // The shortest feasible solution any chain met, or the best penalised one if none was.
+    int reported_chain = best_chain;
+    const vector<vector<int>>* best = &chains[best_chain].best();
+    double best_feasible_distance = numeric_limits<double>::infinity();
+    for (int i = 0; i < chains.size(); ++i) {
+        if (chains[i].problem().best_feasible_distance < best_feasible_distance) {
+            best_feasible_distance = chains[i].problem().best_feasible_distance;
+            best = &chains[i].problem().best_feasible;
+            reported_chain = i;
+        }
+    }
+    const vector<vector<int>>& best_solution = *best;
+    int overload = 0;
+    for (const vector<int>& route : best_solution) {
+        overload += excessLoad(routeDemand(route, customers));
+    }
+    if (overload > 0) {
+        cerr << "No feasible solution found; routes exceed capacity " << capacity << " by " << overload << " in total" << endl;
+    }
+    
+    if (json) {
+        vrp::RunReport report;
+        report.solver = "cvrp";
+        report.instance = instance_name;
+        report.seed = seed;
+        report.collect(chains, reported_chain, elapsed);
+        report.best_cost = calculateTotalDistance(best_solution, dist);
+        report.feasible = overload == 0;
+        if (report.feasible) {
+            report.time_to_best = chains[reported_chain].problem().best_feasible_time;
+        }
+        report.print();
+        return 0;
     }
     
     cout << "Best solution found:" << endl;
@@ -155,8 +663,14 @@ int main() {
         cout << endl;
     }
     
-    double total_distance = calculateTotalDistance(best_solution, customers, {0, depot_x, depot_y});
+    double total_distance = calculateTotalDistance(best_solution, dist);
     cout << "Total distance traveled: " << total_distance << endl;
     
+    cout << "Route loads (capacity " << capacity << "): ";
+    for (const vector<int>& route : best_solution) {
+        cout << routeDemand(route, customers) << " ";
+    }
+    cout << endl;
+    
     return 0;
 }
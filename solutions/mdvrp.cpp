@@ -2,16 +2,31 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include <ctime>
-#include <cstdlib>
 #include <algorithm>
+#include <limits>
+#include "common/adaptive_schedule.h"
+#include "common/annealer.h"
+#include "common/anytime.h"
+#include "common/cli.h"
+#include "common/distance_matrix.h"
+#include "common/instances.h"
+#include "common/parallel_annealing.h"
+#include "common/report.h"
+#include "common/residual_capacity.h"
+#include "common/rng.h"
 
 using namespace std;
 
 const int MAX_VEHICLES = 20;
 const int MAX_CUSTOMERS = 50;
 const double MAX_DISTANCE = 1000.0;
+const int NUM_DEPOTS = 3;
+const int VEHICLE_CAPACITY = 100;
+const int NEAREST_DEPOTS = 5;      // length of each customer's ranked depot list
+const int DEPOT_SWAP_ONE_IN = 10;  // share of proposals that are depot swaps
+const long MAX_ITERATIONS = 1000;  // per chain, without --time-limit
 
+// Customers and depots share the distance matrix: customers first, then the depots.
 struct Customer {
     int demand;
     double x, y;
@@ -20,7 +35,7 @@ struct Customer {
 struct Vehicle {
     int capacity;
     int current_load;
-    int depot;
+    int depot;  // distance-matrix row of the vehicle's depot
     vector<int> route;
 };
 
@@ -29,119 +44,283 @@ struct Solution {
     double cost;
 };
 
-double distance(const Customer& c1, const Customer& c2) {
-    return sqrt(pow(c1.x - c2.x, 2) + pow(c1.y - c2.y, 2));
+// Depot, customers in order, back to the same depot.
+double routeCost(const Vehicle& v, const vrp::DistanceMatrix& dist) {
+    if (v.route.empty()) {
+        return 0.0;
+    }
+    double cost = dist(v.depot, v.route.front()) + dist(v.route.back(), v.depot);
+    for (int j = 0; j + 1 < v.route.size(); ++j) {
+        cost += dist(v.route[j], v.route[j + 1]);
+    }
+    return cost;
+}
+
+double solutionCost(const Solution& solution, const vrp::DistanceMatrix& dist) {
+    double cost = 0.0;
+    for (const Vehicle& v : solution.vehicles) {
+        cost += routeCost(v, dist);
+    }
+    return cost;
+}
+
+// For every customer, the nearest `list_size` depots by distance, nearest first, as
+// distance-matrix rows.
+vector<vector<int>> nearestDepots(int num_customers, int num_depots, int list_size, const vrp::DistanceMatrix& dist) {
+    vector<vector<int>> nearest(num_customers);
+    list_size = min(list_size, num_depots);
+    for (int c = 0; c < num_customers; ++c) {
+        vector<int> depots(num_depots);
+        for (int d = 0; d < num_depots; ++d) {
+            depots[d] = num_customers + d;
+        }
+        partial_sort(depots.begin(), depots.begin() + list_size, depots.end(),
+                     [&](int a, int b) { return dist(c, a) < dist(c, b); });
+        nearest[c].assign(depots.begin(), depots.begin() + list_size);
+    }
+    return nearest;
 }
 
-Solution generateInitialSolution(const vector<Customer>& customers, int num_depots) {
+// The fleet is split evenly over the depots: vehicle i starts from depot i % num_depots.
+// Customers are taken in random order, each onto the first vehicle with room for it; the
+// objective has no capacity penalty, so a customer that fits nowhere is an error.
+Solution generateInitialSolution(const vector<Customer>& customers, const vrp::DistanceMatrix& dist, int num_depots,
+                                 const vector<int>& capacities, vrp::Rng& rng) {
     Solution initial_solution;
     initial_solution.cost = 0.0;
 
-    for (int i = 0; i < MAX_VEHICLES; ++i) {
+    for (int i = 0; i < capacities.size(); ++i) {
         Vehicle v;
-        v.capacity = 100;
+        v.capacity = capacities[i];
         v.current_load = 0;
-        v.depot = i % num_depots;
+        v.depot = customers.size() + i % num_depots;
         initial_solution.vehicles.push_back(v);
     }
+    int num_vehicles = initial_solution.vehicles.size();
 
     vector<int> customer_indices(customers.size());
     for (int i = 0; i < customers.size(); ++i) {
         customer_indices[i] = i;
     }
-    random_shuffle(customer_indices.begin(), customer_indices.end());
+    shuffle(customer_indices.begin(), customer_indices.end(), rng);
 
-    int vehicle_idx = 0;
-    for (int i = 0; i < customers.size(); ++i) {
-        int cust_idx = customer_indices[i];
-        if (initial_solution.vehicles[vehicle_idx].current_load + customers[cust_idx].demand > initial_solution.vehicles[vehicle_idx].capacity) {
-            vehicle_idx = (vehicle_idx + 1) % MAX_VEHICLES;
+    for (int cust_idx : customer_indices) {
+        int vehicle_idx = 0;
+        while (vehicle_idx < num_vehicles && initial_solution.vehicles[vehicle_idx].current_load + customers[cust_idx].demand >
+                                                 initial_solution.vehicles[vehicle_idx].capacity) {
+            ++vehicle_idx;
+        }
+        if (vehicle_idx == num_vehicles) {
+            throw runtime_error("no vehicle has room for customer " + to_string(cust_idx) + " in the initial solution");
         }
         initial_solution.vehicles[vehicle_idx].route.push_back(cust_idx);
         initial_solution.vehicles[vehicle_idx].current_load += customers[cust_idx].demand;
     }
 
-    for (int i = 0; i < initial_solution.vehicles.size(); ++i) {
-        Vehicle& v = initial_solution.vehicles[i];
-        if (!v.route.empty()) {
-            int last_cust_idx = v.route.back();
-            initial_solution.cost += distance(customers[last_cust_idx], customers[v.depot]);
-            for (int j = 0; j < v.route.size() - 1; ++j) {
-                int cust_idx1 = v.route[j];
-                int cust_idx2 = v.route[j + 1];
-                initial_solution.cost += distance(customers[cust_idx1], customers[cust_idx2]);
+    initial_solution.cost = solutionCost(initial_solution, dist);
+
+    return initial_solution;
+}
+
+// RELOCATE moves one customer to position `position` of another vehicle's route.
+// DEPOT_SWAP exchanges the routes of two vehicles based at different depots, so each
+// route is driven from the other depot. Both are priced in O(1) from the two routes they
+// touch and applied only when accepted.
+struct MdvrpMove {
+    static constexpr const char* kOperators[] = {"relocate", "depot_swap"};  // for telemetry, by kind
+    int operatorIndex() const { return kind; }
+
+    enum Kind { RELOCATE, DEPOT_SWAP } kind;
+    int vehicle_idx;
+    int customer_idx;
+    int new_vehicle_idx;
+    int position;
+};
+
+// The current solution with per-vehicle route costs. Vehicles are indexed by spare
+// capacity so that a relocation target that fits the customer is drawn directly, and by
+// depot so that a depot swap can look among the depots nearest to a route.
+struct MdvrpProblem {
+    using Solution = ::Solution;
+
+    const vector<Customer>* customers;
+    const vrp::DistanceMatrix* dist;
+    const vector<vector<int>>* nearest_depots;
+    Solution current;
+    vector<double> route_costs;
+    vrp::ResidualCapacityIndex residuals;
+    vector<vector<int>> depot_vehicles;  // by depot number, i.e. matrix row - number of customers
+
+    MdvrpProblem(const vector<Customer>& customers, const vrp::DistanceMatrix& dist,
+                 const vector<vector<int>>& nearest_depots, const Solution& initial)
+        : customers(&customers), dist(&dist), nearest_depots(&nearest_depots) {
+        for (int i = 0; i < initial.vehicles.size(); ++i) {
+            int depot = initial.vehicles[i].depot - customers.size();
+            if (depot >= depot_vehicles.size()) {
+                depot_vehicles.resize(depot + 1);
             }
+            depot_vehicles[depot].push_back(i);
         }
+        load(initial);
     }
 
-    return initial_solution;
-}
+    double cost() const { return current.cost; }
+    const Solution& solution() const { return current; }
 
-Solution simulatedAnnealing(const vector<Customer>& customers, int num_depots) {
-    srand(time(nullptr));
+    void load(const Solution& solution) {
+        current = solution;
+        int max_capacity = 0;
+        for (const Vehicle& v : current.vehicles) {
+            max_capacity = max(max_capacity, v.capacity);
+        }
+        residuals = vrp::ResidualCapacityIndex(current.vehicles.size(), max_capacity);
+        for (int i = 0; i < current.vehicles.size(); ++i) {
+            residuals.insert(i, current.vehicles[i].capacity - current.vehicles[i].current_load);
+        }
+        resync();
+    }
 
-    double initial_temperature = 1000.0;
-    double alpha = 0.95;
-    int max_iterations = 1000;
+    bool propose(MdvrpMove& move, vrp::Rng& rng) {
+        int num_vehicles = current.vehicles.size();
+        move.vehicle_idx = rng.uniformInt(num_vehicles);
+        const Vehicle& from = current.vehicles[move.vehicle_idx];
+        if (from.route.empty()) {
+            return false;
+        }
 
-    Solution current_solution = generateInitialSolution(customers, num_depots);
-    Solution best_solution = current_solution;
+        if (depot_vehicles.size() > 1 && rng.uniformInt(DEPOT_SWAP_ONE_IN) == 0) {
+            move.kind = MdvrpMove::DEPOT_SWAP;
+            const vector<int>& nearest = (*nearest_depots)[from.route[rng.uniformInt(from.route.size())]];
+            const vector<int>& candidates = depot_vehicles[nearest[rng.uniformInt(nearest.size())] - customers->size()];
+            move.new_vehicle_idx = candidates[rng.uniformInt(candidates.size())];
+            const Vehicle& to = current.vehicles[move.new_vehicle_idx];
+            return to.depot != from.depot && from.current_load <= to.capacity && to.current_load <= from.capacity;
+        }
 
-    double current_temperature = initial_temperature;
+        move.kind = MdvrpMove::RELOCATE;
+        move.customer_idx = rng.uniformInt(from.route.size());
+        move.new_vehicle_idx = residuals.sample((*customers)[from.route[move.customer_idx]].demand, rng, move.vehicle_idx);
+        if (move.new_vehicle_idx < 0) {
+            return false;
+        }
+        move.position = rng.uniformInt(current.vehicles[move.new_vehicle_idx].route.size() + 1);
+        return true;
+    }
 
-    for (int iter = 0; iter < max_iterations; ++iter) {
-        Solution new_solution = current_solution;
+    // Cost of v's route driven from `depot` instead: only the first and last legs change.
+    double routeCostFrom(int vehicle_idx, int depot) const {
+        const Vehicle& v = current.vehicles[vehicle_idx];
+        if (v.route.empty()) {
+            return 0.0;
+        }
+        const vrp::DistanceMatrix& d = *dist;
+        return route_costs[vehicle_idx] - d(v.depot, v.route.front()) - d(v.route.back(), v.depot)
+             + d(depot, v.route.front()) + d(v.route.back(), depot);
+    }
 
-        int vehicle_idx = rand() % MAX_VEHICLES;
-        if (!new_solution.vehicles[vehicle_idx].route.empty()) {
-            int customer_idx = rand() % new_solution.vehicles[vehicle_idx].route.size();
-            int selected_customer = new_solution.vehicles[vehicle_idx].route[customer_idx];
-            
-            int new_vehicle_idx = rand() % MAX_VEHICLES;
-            while (new_vehicle_idx == vehicle_idx || new_solution.vehicles[new_vehicle_idx].current_load + customers[selected_customer].demand > new_solution.vehicles[new_vehicle_idx].capacity) {
-                new_vehicle_idx = rand() % MAX_VEHICLES;
-            }
+    double evaluate(MdvrpMove& move) {
+        const vrp::DistanceMatrix& d = *dist;
+        const Vehicle& from = current.vehicles[move.vehicle_idx];
+        const Vehicle& to = current.vehicles[move.new_vehicle_idx];
+        if (move.kind == MdvrpMove::DEPOT_SWAP) {
+            return routeCostFrom(move.vehicle_idx, to.depot) + routeCostFrom(move.new_vehicle_idx, from.depot)
+                 - route_costs[move.vehicle_idx] - route_costs[move.new_vehicle_idx];
+        }
+        int customer = from.route[move.customer_idx];
+        int prev = move.customer_idx == 0 ? from.depot : from.route[move.customer_idx - 1];
+        int next = move.customer_idx + 1 == from.route.size() ? from.depot : from.route[move.customer_idx + 1];
+        int before = move.position == 0 ? to.depot : to.route[move.position - 1];
+        int after = move.position == to.route.size() ? to.depot : to.route[move.position];
+        return d(prev, next) - d(prev, customer) - d(customer, next)
+             + d(before, customer) + d(customer, after) - d(before, after);
+    }
 
-            new_solution.vehicles[vehicle_idx].route.erase(new_solution.vehicles[vehicle_idx].route.begin() + customer_idx);
-            new_solution.vehicles[new_vehicle_idx].route.push_back(selected_customer);
-            new_solution.vehicles[new_vehicle_idx].current_load += customers[selected_customer].demand;
-
-            new_solution.cost = 0.0;
-            for (int i = 0; i < new_solution.vehicles.size(); ++i) {
-                Vehicle& v = new_solution.vehicles[i];
-                if (!v.route.empty()) {
-                    int last_cust_idx = v.route.back();
-                    new_solution.cost += distance(customers[last_cust_idx], customers[v.depot]);
-                    for (int j = 0; j < v.route.size() - 1; ++j) {
-                        int cust_idx1 = v.route[j];
-                        int cust_idx2 = v.route[j + 1];
-                        new_solution.cost += distance(customers[cust_idx1], customers[cust_idx2]);
-                    }
-                }
-            }
+    void commit(MdvrpMove& move) {
+        Vehicle& from = current.vehicles[move.vehicle_idx];
+        Vehicle& to = current.vehicles[move.new_vehicle_idx];
+        if (move.kind == MdvrpMove::DEPOT_SWAP) {
+            swap(from.route, to.route);
+            swap(from.current_load, to.current_load);
+        } else {
+            int customer = from.route[move.customer_idx];
+            int demand = (*customers)[customer].demand;
+            from.route.erase(from.route.begin() + move.customer_idx);
+            to.route.insert(to.route.begin() + move.position, customer);
+            from.current_load -= demand;
+            to.current_load += demand;
+        }
+        residuals.update(move.vehicle_idx, from.capacity - from.current_load);
+        residuals.update(move.new_vehicle_idx, to.capacity - to.current_load);
+        current.cost -= route_costs[move.vehicle_idx] + route_costs[move.new_vehicle_idx];
+        route_costs[move.vehicle_idx] = routeCost(from, *dist);
+        route_costs[move.new_vehicle_idx] = routeCost(to, *dist);
+        current.cost += route_costs[move.vehicle_idx] + route_costs[move.new_vehicle_idx];
+    }
 
-            double rand_num = (rand() % 100) / 100.0;
-            double delta_cost = new_solution.cost - current_solution.cost;
-            if (delta_cost < 0 || exp(-delta_cost / current_temperature) > rand_num) {
-                current_solution = new_solution;
-            }
+    void revert(MdvrpMove&) {}
 
-            if (current_solution.cost < best_solution.cost) {
-                best_solution = current_solution;
-            }
+    void resync() {
+        route_costs.resize(current.vehicles.size());
+        current.cost = 0.0;
+        for (int i = 0; i < current.vehicles.size(); ++i) {
+            route_costs[i] = routeCost(current.vehicles[i], *dist);
+            current.cost += route_costs[i];
         }
+    }
+};
+
+using MdvrpAnnealer = vrp::Annealer<MdvrpProblem, MdvrpMove, vrp::AdaptiveSchedule>;
 
-        current_temperature *= alpha;
+// Returns the index of the chain holding the best solution. A deadline replaces the
+// iteration budget, and the schedule cools over whichever applies.
+int simulatedAnnealing(vector<MdvrpAnnealer>& chains, const vector<Customer>& customers, const vrp::DistanceMatrix& dist,
+                       const vector<vector<int>>& nearest_depots, int num_depots, const vector<int>& capacities,
+                       const vrp::AnytimeOptions& anytime, vrp::ProgressStream& progress, vrp::TraceWriter& trace,
+                       const vrp::ParallelOptions& parallel, vrp::Rng& rng) {
+    double initial_temperature = 1000.0;
+
+    MdvrpAnnealer::Options options;
+    anytime.configure(options, progress);
+    vrp::AdaptiveScheduleOptions schedule = vrp::AdaptiveScheduleOptions::budget(MAX_ITERATIONS, anytime.deadline.remaining());
+    for (int i = 0; i < parallel.num_chains; ++i) {
+        vrp::Rng chain_rng = rng.split();
+        MdvrpProblem problem(customers, dist, nearest_depots,
+                             generateInitialSolution(customers, dist, num_depots, capacities, chain_rng));
+        trace.configure(options, i);
+        chains.emplace_back(problem, vrp::AdaptiveSchedule(initial_temperature, schedule), chain_rng, options);
+        chains.back().calibrateTemperature(schedule.initial_acceptance);
     }
+    return vrp::runChains(chains, anytime.iterationBudget(MAX_ITERATIONS), parallel, rng);
+}
 
-    return best_solution;
+// Cordeau MDVRP: `vehicles` per depot, each with that depot's capacity. Routes are not
+// timed, so instances with duration limits or service times are rejected.
+void loadInstance(const vrp::CordeauInstance& instance, vector<Customer>& customers, vector<Customer>& depots, vector<int>& capacities) {
+    for (const vrp::CordeauInstance::Limit& limit : instance.limits) {
+        if (limit.max_duration > 0) {
+            throw runtime_error(instance.name + " limits route duration, which mdvrp does not support");
+        }
+    }
+    for (const vrp::CordeauInstance::Customer& c : instance.customers) {
+        if (c.service_time > 0) {
+            throw runtime_error(instance.name + " has service times, which mdvrp does not support");
+        }
+        customers.push_back({c.demand, c.x, c.y});
+    }
+    for (const vrp::CordeauInstance::Point& d : instance.depots) {
+        depots.push_back({0, d.x, d.y});
+    }
+    int num_depots = depots.size();
+    for (int i = 0; i < instance.vehicles * num_depots; ++i) {
+        capacities.push_back(instance.limits[i % num_depots].capacity);
+    }
 }
 
 void printSolution(const Solution& solution, const vector<Customer>& customers) {
     cout << "Total Cost: " << solution.cost << endl;
     for (int i = 0; i < solution.vehicles.size(); ++i) {
         const Vehicle& v = solution.vehicles[i];
-        cout << "Vehicle " << i << " (Depot " << v.depot << ") Route: ";
+        cout << "Vehicle " << i << " (Depot " << v.depot - (int)customers.size() << ") Route: ";
         for (int j = 0; j < v.route.size(); ++j) {
             cout << v.route[j] << " ";
         }
@@ -149,22 +328,83 @@ void printSolution(const Solution& solution, const vector<Customer>& customers)
     }
 }
 
-int main() {
-    srand(time(nullptr));
+int main(int argc, char** argv) {
+    uint64_t seed = vrp::seedArg(argc, argv, vrp::timeSeed());
+    vrp::Rng rng(seed);
+
+    vrp::ParallelOptions parallel = vrp::parallelOptionsFromArgs(argc, argv, 100);
+    string instance_path = vrp::stringArg(argc, argv, "--instance", "");
+    vrp::AnytimeOptions anytime = vrp::anytimeOptionsFromArgs(argc, argv);
+    bool json = vrp::hasFlag(argc, argv, "--json");
 
-    vector<Customer> customers(MAX_CUSTOMERS);
-    for (int i = 0; i < MAX_CUSTOMERS; ++i) {
-        customers[i].demand = rand() % 10 + 1;
-        customers[i].x = (rand() / (double)RAND_MAX) * MAX_DISTANCE;
-        customers[i].y = (rand() / (double)RAND_MAX) * MAX_DISTANCE;
+    vector<Customer> customers;
+    vector<Customer> depots;
+    vector<int> capacities;
+    string instance_name = "random";
+    if (!instance_path.empty()) {
+        try {
+            vrp::CordeauInstance instance = vrp::loadCordeau(instance_path);
+            if (instance.type != 2) {
+                throw runtime_error(instance_path + " is not an MDVRP instance");
+            }
+            instance_name = instance.name;
+            loadInstance(instance, customers, depots, capacities);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    } else {
+        customers.resize(MAX_CUSTOMERS);
+        for (int i = 0; i < MAX_CUSTOMERS; ++i) {
+            customers[i].demand = rng.uniformInt(10) + 1;
+            customers[i].x = rng.uniform01() * MAX_DISTANCE;
+            customers[i].y = rng.uniform01() * MAX_DISTANCE;
+        }
+        depots.resize(NUM_DEPOTS);
+        for (Customer& depot : depots) {
+            depot = {0, rng.uniform01() * MAX_DISTANCE, rng.uniform01() * MAX_DISTANCE};
+        }
+        capacities.assign(MAX_VEHICLES, VEHICLE_CAPACITY);
     }
 
-    int num_depots = 3;
+    vector<Customer> nodes = customers;
+    nodes.insert(nodes.end(), depots.begin(), depots.end());
+    vrp::DistanceMatrix dist = vrp::DistanceMatrix::euclidean(nodes);
+    vector<vector<int>> nearest_depots = nearestDepots(customers.size(), depots.size(), NEAREST_DEPOTS, dist);
+
+    vrp::TraceWriter trace = vrp::traceFromArgs<MdvrpMove>(argc, argv);  // outlives the chains, which flush into it
+    vector<MdvrpAnnealer> chains;
+    vrp::Stopwatch stopwatch;
+    vrp::ProgressStream progress;
+    int best_chain;
+    try {
+        best_chain = simulatedAnnealing(chains, customers, dist, nearest_depots, depots.size(), capacities, anytime, progress,
+                                        trace, parallel, rng);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    double elapsed = stopwatch.seconds();
 
-    Solution best_solution = simulatedAnnealing(customers, num_depots);
+    if (json) {
+        vrp::RunReport report;
+        report.solver = "mdvrp";
+        report.instance = instance_name;
+        report.seed = seed;
+        report.collect(chains, best_chain, elapsed);
+        for (const Vehicle& v : chains[best_chain].best().vehicles) {
+            int load = 0;
+            for (int customer : v.route) {
+                load += customers[customer].demand;
+            }
+            report.feasible = report.feasible && load <= v.capacity;
+        }
+        report.print();
+        return 0;
+    }
 
     cout << "Best Solution:" << endl;
-    printSolution(best_solution, customers);
+    printSolution(chains[best_chain].best(), customers);
 
     return 0;
 }
@@ -3,139 +3,570 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
-#include <random>
-#include <chrono>
+#include <limits>
+#include "common/adaptive_schedule.h"
+#include "common/annealer.h"
+#include "common/cli.h"
+#include "common/distance_matrix.h"
+#include "common/instances.h"
+#include "common/parallel_annealing.h"
+#include "common/report.h"
+#include "common/rng.h"
+#include "common/thread_pool.h"
 
 using namespace std;
 
-const int NUM_CUSTOMERS = 20;   
-const int NUM_VEHICLES = 4;       
-const int VEHICLE_CAPACITY = 10;  
-const int MAX_ITER = 10000;       
+const int NUM_CUSTOMERS = 20;
+const int NUM_VEHICLES = 4;
+const int VEHICLE_CAPACITY = 10;
+const int MAX_ITER = 10000;       // per day and round
 const double INITIAL_TEMP = 100.0;
-const double COOLING_RATE = 0.003;
-const int PERIOD_LENGTH = 7;      
+const int PERIOD_LENGTH = 7;
+const double MAX_COORDINATE = 100.0;
+const int ROUNDS = 4;             // alternations of day annealing and pattern reassignment
+const int PATTERN_ITER = 2000;    // pattern moves per round
+const double WARM_START_TEMP = 0.1;  // fraction of INITIAL_TEMP for the pattern phase after the first round
+const double WARM_START_ACCEPTANCE = 0.05;  // starting acceptance for days that start from earlier routes
+const double LOAD_PENALTY = 100.0;
+const double DURATION_PENALTY = 100.0;
+const int RESYNC_INTERVAL = 1000;    // iterations between full recomputations of a day's cached cost
+
+// customers[0] is the depot. Each pattern is a bit mask of the days a customer is visited
+// on; a plan picks one pattern per customer.
 struct Customer {
     int id;
+    double x, y;
     int demand;
+    double service_time;
+    vector<int> patterns;
 };
-struct Depot {
-    int id;
+
+struct PvrpInstance {
+    vector<Customer> customers;
+    int days;
+    int vehicles;                 // per day
+    int capacity;
+    double max_duration;          // 0 means unconstrained
+    vrp::DistanceMatrix dist;
+};
+
+// Routes of one day, one per vehicle.
+using DayRoutes = vector<vector<int>>;
+
+// A weekly plan: the chosen pattern of every customer and the routes that visit it on
+// the pattern's days.
+struct Plan {
+    vector<int> pattern;
+    vector<DayRoutes> days;
+    vector<double> day_costs;
+    double cost;
+};
+
+bool visits(int pattern, int day) {
+    return (pattern >> day) & 1;
+}
+
+struct RouteStats {
+    double distance;
+    double service;
+    int load;
 };
-double distance(const Customer& c1, const Customer& c2) {
-    return sqrt(pow(c1.id - c2.id, 2));
+
+RouteStats calculate_route_stats(const vector<int>& route, const PvrpInstance& instance) {
+    RouteStats stats = {0.0, 0.0, 0};
+    if (route.empty()) {
+        return stats;
+    }
+    int prev = 0;
+    for (int customer : route) {
+        stats.distance += instance.dist(prev, customer);
+        stats.service += instance.customers[customer].service_time;
+        stats.load += instance.customers[customer].demand;
+        prev = customer;
+    }
+    stats.distance += instance.dist(prev, 0);
+    return stats;
 }
 
-double calculate_route_distance(const vector<int>& route, const vector<Customer>& customers) {
-    double total_distance = 0.0;
-    for (int i = 0; i < route.size() - 1; ++i) {
-        total_distance += distance(customers[route[i]], customers[route[i + 1]]);
+// Distance penalised for overload and for running past the duration limit.
+double route_cost(const RouteStats& stats, const PvrpInstance& instance) {
+    double cost = stats.distance + LOAD_PENALTY * max(0, stats.load - instance.capacity);
+    if (instance.max_duration > 0) {
+        cost += DURATION_PENALTY * max(0.0, stats.distance + stats.service - instance.max_duration);
     }
-    total_distance += distance(customers[route.back()], customers[0]);
-    return total_distance;
+    return cost;
 }
 
-vector<vector<int>> generate_initial_solution(const vector<Customer>& customers) {
-    vector<vector<int>> initial_solution(NUM_VEHICLES);
-
-    int current_capacity = 0;
-    int current_vehicle = 0;
-    vector<bool> visited(customers.size(), false);
-    visited[0] = true;
-    int current_customer = 0; 
-    while (true) {
-        int nearest_customer = -1;
-        double min_distance = numeric_limits<double>::max();
-        for (int i = 1; i < customers.size(); ++i) {
-            if (!visited[i] && customers[i].demand + current_capacity <= VEHICLE_CAPACITY) {
-                double dist = distance(customers[current_customer], customers[i]);
-                if (dist < min_distance) {
-                    min_distance = dist;
-                    nearest_customer = i;
-                }
+double calculate_route_cost(const vector<int>& route, const PvrpInstance& instance) {
+    return route.empty() ? 0.0 : route_cost(calculate_route_stats(route, instance), instance);
+}
+
+double calculate_day_cost(const DayRoutes& routes, const PvrpInstance& instance) {
+    double total_cost = 0.0;
+    for (const vector<int>& route : routes) {
+        total_cost += calculate_route_cost(route, instance);
+    }
+    return total_cost;
+}
+
+// Where a customer enters or leaves one day's routes, and what that does to the day's cost.
+struct DayChange {
+    int day;
+    int vehicle, position;
+    double delta;
+};
+
+// Tries every position on every vehicle of the day, each priced in O(1) from the route's
+// totals.
+DayChange cheapest_insertion(const DayRoutes& routes, int day, int customer, const PvrpInstance& instance) {
+    DayChange best = {day, 0, 0, numeric_limits<double>::infinity()};
+    const Customer& c = instance.customers[customer];
+    for (int v = 0; v < (int)routes.size(); ++v) {
+        const vector<int>& route = routes[v];
+        RouteStats stats = calculate_route_stats(route, instance);
+        double old_cost = calculate_route_cost(route, instance);
+        for (int k = 0; k <= (int)route.size(); ++k) {
+            int prev = k == 0 ? 0 : route[k - 1];
+            int next = k == (int)route.size() ? 0 : route[k];
+            RouteStats inserted = {stats.distance + instance.dist(prev, customer) + instance.dist(customer, next)
+                                       - instance.dist(prev, next),
+                                   stats.service + c.service_time, stats.load + c.demand};
+            double delta = route_cost(inserted, instance) - old_cost;
+            if (delta < best.delta) {
+                best = {day, v, k, delta};
             }
         }
-        if (nearest_customer == -1) {
-            current_vehicle++;
-            if (current_vehicle >= NUM_VEHICLES) {
-                break; 
-            }
-            current_capacity = 0;
-            current_customer = 0;
-        } else {
-           initial_solution[current_vehicle].push_back(nearest_customer);
-            visited[nearest_customer] = true;
-            current_capacity += customers[nearest_customer].demand;
-            current_customer = nearest_customer;
+    }
+    return best;
+}
+
+DayChange removal(const DayRoutes& routes, int day, int customer, const PvrpInstance& instance) {
+    const Customer& c = instance.customers[customer];
+    for (int v = 0; v < (int)routes.size(); ++v) {
+        const vector<int>& route = routes[v];
+        int k = find(route.begin(), route.end(), customer) - route.begin();
+        if (k == (int)route.size()) {
+            continue;
+        }
+        double old_cost = calculate_route_cost(route, instance);
+        double new_cost = 0.0;
+        if (route.size() > 1) {
+            RouteStats stats = calculate_route_stats(route, instance);
+            int prev = k == 0 ? 0 : route[k - 1];
+            int next = k + 1 == (int)route.size() ? 0 : route[k + 1];
+            RouteStats removed = {stats.distance - instance.dist(prev, customer) - instance.dist(customer, next)
+                                      + instance.dist(prev, next),
+                                  stats.service - c.service_time, stats.load - c.demand};
+            new_cost = route_cost(removed, instance);
         }
+        return {day, v, k, new_cost - old_cost};
     }
+    return {day, -1, -1, 0.0};
+}
 
-    return initial_solution;
+void apply_change(Plan& plan, const DayChange& change, int customer, bool insert) {
+    vector<int>& route = plan.days[change.day][change.vehicle];
+    if (insert) {
+        route.insert(route.begin() + change.position, customer);
+    } else {
+        route.erase(route.begin() + change.position);
+    }
+    plan.day_costs[change.day] += change.delta;
+    plan.cost += change.delta;
 }
-vector<vector<int>> simulated_annealing(const vector<Customer>& customers) {
-    vector<vector<int>> current_solution = generate_initial_solution(customers);
-    vector<vector<int>> best_solution = current_solution;
-    double temperature = INITIAL_TEMP;
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<> dis(0.0, 1.0);
-    for (int iter = 0; iter < MAX_ITER; ++iter) {
-        vector<vector<int>> new_solution = current_solution;
-        int vehicle1 = rand() % NUM_VEHICLES;
-        int vehicle2 = rand() % NUM_VEHICLES;
-        if (vehicle1 != vehicle2 && !new_solution[vehicle1].empty() && !new_solution[vehicle2].empty()) {
-            int rand_index1 = rand() % new_solution[vehicle1].size();
-            int rand_index2 = rand() % new_solution[vehicle2].size();
-            swap(new_solution[vehicle1][rand_index1], new_solution[vehicle2][rand_index2]);
-        }
-        double current_cost = 0.0;
-        double new_cost = 0.0;
-        for (int v = 0; v < NUM_VEHICLES; ++v) {
-            current_cost += calculate_route_distance(current_solution[v], customers);
-            new_cost += calculate_route_distance(new_solution[v], customers);
+
+// Random allowed pattern per customer; each day's visits are then added one at a time at
+// their cheapest position.
+Plan generate_initial_plan(const PvrpInstance& instance, vrp::Rng& rng) {
+    Plan plan;
+    int n = instance.customers.size();
+    plan.pattern.assign(n, 0);
+    plan.days.assign(instance.days, DayRoutes(instance.vehicles));
+    plan.day_costs.assign(instance.days, 0.0);
+    plan.cost = 0.0;
+
+    vector<int> order;
+    for (int i = 1; i < n; ++i) {
+        const vector<int>& patterns = instance.customers[i].patterns;
+        plan.pattern[i] = patterns[rng.uniformInt(patterns.size())];
+        order.push_back(i);
+    }
+    shuffle(order.begin(), order.end(), rng);
+    for (int customer : order) {
+        for (int d = 0; d < instance.days; ++d) {
+            if (visits(plan.pattern[customer], d)) {
+                apply_change(plan, cheapest_insertion(plan.days[d], d, customer, instance), customer, true);
+            }
+        }
+    }
+    return plan;
+}
+
+// Swap of two customers between vehicles, or relocation of one customer to a position on
+// any vehicle (index2 counts positions after the removal).
+struct DayMove {
+    enum Kind { SWAP, RELOCATE } kind;
+    int vehicle1, index1;
+    int vehicle2, index2;
+    double old_cost1, old_cost2;
+};
+
+// Cost of every route of a day and their running sum. A move marks the routes it touches
+// dirty and refresh() re-costs only those, so an evaluation walks at most two routes.
+struct RouteCostCache {
+    vector<double> costs;
+    vector<int> dirty;  // vehicles whose route changed since the last refresh
+    double total = 0.0;
+
+    void rebuild(const DayRoutes& routes, const PvrpInstance& instance) {
+        costs.resize(routes.size());
+        dirty.clear();
+        total = 0.0;
+        for (size_t v = 0; v < routes.size(); ++v) {
+            costs[v] = calculate_route_cost(routes[v], instance);
+            total += costs[v];
+        }
+    }
+
+    void invalidate(int vehicle) {
+        if (find(dirty.begin(), dirty.end(), vehicle) == dirty.end()) {
+            dirty.push_back(vehicle);
+        }
+    }
+
+    void refresh(const DayRoutes& routes, const PvrpInstance& instance) {
+        for (int v : dirty) {
+            double cost = calculate_route_cost(routes[v], instance);
+            total += cost - costs[v];
+            costs[v] = cost;
+        }
+        dirty.clear();
+    }
+
+    // Puts back a cost saved before the route changed, for routes restored by an undo.
+    void restore(int vehicle, double cost) {
+        total += cost - costs[vehicle];
+        costs[vehicle] = cost;
+    }
+};
+
+// One day's routes, changed in place by a move and restored on rejection.
+struct DayProblem {
+    using Solution = DayRoutes;
+    const PvrpInstance* instance;
+    Solution routes;
+    RouteCostCache route_costs;
+    DayProblem(const PvrpInstance& instance, const Solution& initial)
+        : instance(&instance) {
+        load(initial);
+    }
+    double cost() const { return route_costs.total; }
+    const Solution& solution() const { return routes; }
+    void load(const Solution& solution) {
+        routes = solution;
+        resync();
+    }
+    bool propose(DayMove& move, vrp::Rng& rng) {
+        int num_vehicles = routes.size();
+        move.vehicle1 = rng.uniformInt(num_vehicles);
+        move.vehicle2 = rng.uniformInt(num_vehicles);
+        if (routes[move.vehicle1].empty()) {
+            return false;
+        }
+        move.index1 = rng.uniformInt(routes[move.vehicle1].size());
+        if (rng.uniformInt(2) == 0) {
+            move.kind = DayMove::SWAP;
+            if (move.vehicle1 == move.vehicle2 || routes[move.vehicle2].empty()) {
+                return false;
+            }
+            move.index2 = rng.uniformInt(routes[move.vehicle2].size());
+        } else {
+            move.kind = DayMove::RELOCATE;
+            int target_size = routes[move.vehicle2].size() - (move.vehicle1 == move.vehicle2 ? 1 : 0);
+            move.index2 = rng.uniformInt(target_size + 1);
+        }
+        return true;
+    }
+    double evaluate(DayMove& move) {
+        double old_total = route_costs.total;
+        move.old_cost1 = route_costs.costs[move.vehicle1];
+        move.old_cost2 = route_costs.costs[move.vehicle2];
+        if (move.kind == DayMove::SWAP) {
+            swap(routes[move.vehicle1][move.index1], routes[move.vehicle2][move.index2]);
+        } else {
+            int customer = routes[move.vehicle1][move.index1];
+            routes[move.vehicle1].erase(routes[move.vehicle1].begin() + move.index1);
+            routes[move.vehicle2].insert(routes[move.vehicle2].begin() + move.index2, customer);
         }
-        if (new_cost < current_cost) {
-            current_solution = new_solution;
+        route_costs.invalidate(move.vehicle1);
+        route_costs.invalidate(move.vehicle2);
+        route_costs.refresh(routes, *instance);
+        return route_costs.total - old_total;
+    }
+    void commit(DayMove&) {}
+    void revert(DayMove& move) {
+        if (move.kind == DayMove::SWAP) {
+            swap(routes[move.vehicle1][move.index1], routes[move.vehicle2][move.index2]);
         } else {
-            double acceptance_probability = exp((current_cost - new_cost) / temperature);
-            double random_value = dis(gen);
-            if (random_value < acceptance_probability) {
-                current_solution = new_solution;
+            int customer = routes[move.vehicle2][move.index2];
+            routes[move.vehicle2].erase(routes[move.vehicle2].begin() + move.index2);
+            routes[move.vehicle1].insert(routes[move.vehicle1].begin() + move.index1, customer);
+        }
+        route_costs.restore(move.vehicle1, move.old_cost1);
+        route_costs.restore(move.vehicle2, move.old_cost2);
+    }
+    void resync() { route_costs.rebuild(routes, *instance); }
+};
+
+// Gives a customer another of its patterns: it leaves the days only the old pattern has
+// and is inserted at the cheapest position on the days only the new one has. Every other
+// day is untouched and keeps its cost.
+struct PatternMove {
+    int customer;
+    int pattern;
+    vector<DayChange> removals;
+    vector<DayChange> insertions;
+};
+
+// The whole plan under pattern moves, priced in evaluate() and applied in commit().
+struct PatternProblem {
+    using Solution = Plan;
+    const PvrpInstance* instance;
+    Plan current;
+    PatternProblem(const PvrpInstance& instance, const Plan& initial) : instance(&instance), current(initial) {}
+    double cost() const { return current.cost; }
+    const Solution& solution() const { return current; }
+    void load(const Solution& solution) { current = solution; }
+    bool propose(PatternMove& move, vrp::Rng& rng) {
+        move.customer = 1 + rng.uniformInt(instance->customers.size() - 1);
+        const vector<int>& patterns = instance->customers[move.customer].patterns;
+        move.pattern = patterns[rng.uniformInt(patterns.size())];
+        return move.pattern != current.pattern[move.customer];
+    }
+    double evaluate(PatternMove& move) {
+        int old_pattern = current.pattern[move.customer];
+        move.removals.clear();
+        move.insertions.clear();
+        double delta = 0.0;
+        for (int d = 0; d < instance->days; ++d) {
+            if (visits(old_pattern, d) && !visits(move.pattern, d)) {
+                move.removals.push_back(removal(current.days[d], d, move.customer, *instance));
+                delta += move.removals.back().delta;
+            } else if (!visits(old_pattern, d) && visits(move.pattern, d)) {
+                move.insertions.push_back(cheapest_insertion(current.days[d], d, move.customer, *instance));
+                delta += move.insertions.back().delta;
+            }
+        }
+        return delta;
+    }
+    void commit(PatternMove& move) {
+        for (const DayChange& change : move.removals) {
+            apply_change(current, change, move.customer, false);
+        }
+        for (const DayChange& change : move.insertions) {
+            apply_change(current, change, move.customer, true);
+        }
+        current.pattern[move.customer] = move.pattern;
+    }
+    void revert(PatternMove&) {}
+    void resync() {
+        current.cost = 0.0;
+        for (int d = 0; d < instance->days; ++d) {
+            current.day_costs[d] = calculate_day_cost(current.days[d], *instance);
+            current.cost += current.day_costs[d];
+        }
+    }
+};
+
+struct SearchStats {
+    long iterations = 0;
+    double time_to_best = 0.0;
+};
+
+// Alternates two phases. First every day's routes are annealed with the day's visits
+// fixed, all days at once on a thread pool, under an adaptive schedule spread over the
+// day's iterations or share of the time; after the first round each day starts from its
+// previous routes at a lower acceptance. Then the visits are fixed per day but
+// customers may change pattern. With a time limit, each round gets an equal share of it.
+Plan simulated_annealing(const PvrpInstance& instance, double time_limit, const vrp::ParallelOptions& parallel,
+                         vrp::Rng& rng, SearchStats& stats) {
+    using DayAnnealer = vrp::Annealer<DayProblem, DayMove, vrp::AdaptiveSchedule>;
+    using PatternAnnealer = vrp::Annealer<PatternProblem, PatternMove, vrp::GeometricSchedule>;
+    vrp::Stopwatch stopwatch;
+    vrp::ThreadPool pool(min<unsigned>(instance.days, max(1u, thread::hardware_concurrency())));
+    Plan plan = generate_initial_plan(instance, rng);
+    long day_iterations = time_limit > 0 ? numeric_limits<long>::max() : MAX_ITER;
+
+    for (int round = 0; round < ROUNDS; ++round) {
+        double temperature = round == 0 ? INITIAL_TEMP : INITIAL_TEMP * WARM_START_TEMP;
+        DayAnnealer::Options options;
+        options.resync_interval = RESYNC_INTERVAL;
+        if (time_limit > 0) {
+            // Days beyond the pool size wait for a free thread, so they share the round's time.
+            int waves = (instance.days + pool.size() - 1) / pool.size();
+            options.time_limit = max(1e-3, (time_limit - stopwatch.seconds()) / (ROUNDS - round) / waves);
+        }
+        vrp::AdaptiveScheduleOptions schedule = vrp::AdaptiveScheduleOptions::budget(MAX_ITER, options.time_limit);
+        if (round > 0) {
+            schedule.initial_acceptance = WARM_START_ACCEPTANCE;
+        }
+        vector<vrp::Rng> day_rngs;
+        for (int d = 0; d < instance.days; ++d) {
+            day_rngs.push_back(rng.split());
+        }
+        vector<long> iterations(instance.days, 0);
+        pool.parallelFor(instance.days, [&](int d) {
+            vector<DayAnnealer> chains;
+            for (int i = 0; i < parallel.num_chains; ++i) {
+                chains.emplace_back(DayProblem(instance, plan.days[d]), vrp::AdaptiveSchedule(temperature, schedule),
+                                    day_rngs[d].split(), options);
+                chains.back().calibrateTemperature(schedule.initial_acceptance);
             }
+            int best_chain = vrp::runChains(chains, day_iterations, parallel, day_rngs[d]);
+            plan.days[d] = chains[best_chain].best();
+            plan.day_costs[d] = chains[best_chain].bestCost();
+            for (const DayAnnealer& chain : chains) {
+                iterations[d] += chain.iterations();
+            }
+        });
+        double cost_before = plan.cost;
+        plan.cost = 0.0;
+        for (int d = 0; d < instance.days; ++d) {
+            plan.cost += plan.day_costs[d];
+            stats.iterations += iterations[d];
+        }
+
+        PatternAnnealer patterns(PatternProblem(instance, plan),
+                                 vrp::GeometricSchedule(temperature, pow(0.01, 1.0 / PATTERN_ITER)), rng.split());
+        patterns.run(PATTERN_ITER);
+        stats.iterations += patterns.iterations();
+        plan = patterns.best();
+        if (plan.cost < cost_before) {
+            stats.time_to_best = stopwatch.seconds();
         }
-        if (calculate_route_distance(current_solution[0], customers) < calculate_route_distance(best_solution[0], customers)) {
-            best_solution = current_solution;
+    }
+    return plan;
+}
+
+// Every visit pattern of `frequency` days spread evenly over the period.
+vector<int> even_patterns(int frequency, int days) {
+    vector<int> patterns;
+    int spacing = days / frequency;
+    for (int start = 0; start + (frequency - 1) * spacing < days; ++start) {
+        int pattern = 0;
+        for (int k = 0; k < frequency; ++k) {
+            pattern |= 1 << (start + k * spacing);
         }
-        temperature *= (1 - COOLING_RATE);
+        patterns.push_back(pattern);
     }
-    return best_solution;
+    return patterns;
 }
 
-int main() {
-    vector<Customer> customers(NUM_CUSTOMERS + 1);  
+PvrpInstance random_instance(vrp::Rng& rng) {
+    PvrpInstance instance;
+    instance.days = PERIOD_LENGTH;
+    instance.vehicles = NUM_VEHICLES;
+    instance.capacity = VEHICLE_CAPACITY;
+    instance.max_duration = 0.0;
+    instance.customers.resize(NUM_CUSTOMERS + 1);
+    instance.customers[0] = {0, MAX_COORDINATE / 2, MAX_COORDINATE / 2, 0, 0.0, {}};
     for (int i = 1; i <= NUM_CUSTOMERS; ++i) {
-        customers[i].id = i;
-        customers[i].demand = rand() % 5 + 1;  
-    }
-    for (int period = 0; period < PERIOD_LENGTH; ++period) {
-        auto start_time = chrono::high_resolution_clock::now();
-        vector<vector<int>> solution = simulated_annealing(customers);
-        auto end_time = chrono::high_resolution_clock::now();
-        cout << "Best solution found for Day " << period + 1 << ":" << endl;
-        for (int v = 0; v < NUM_VEHICLES; ++v) {
+        Customer& customer = instance.customers[i];
+        customer.id = i;
+        customer.x = rng.uniform01() * MAX_COORDINATE;
+        customer.y = rng.uniform01() * MAX_COORDINATE;
+        customer.demand = rng.uniformInt(5) + 1;
+        customer.service_time = 0.0;
+        customer.patterns = even_patterns(rng.uniformInt(1, 3), PERIOD_LENGTH);
+    }
+    return instance;
+}
+
+// Cordeau's type 1 files: one depot, the same limits every day, and the allowed visit
+// combinations of each customer given as day bit masks.
+PvrpInstance load_instance(const vrp::CordeauInstance& cordeau) {
+    PvrpInstance instance;
+    instance.days = cordeau.periods;
+    instance.vehicles = cordeau.vehicles;
+    instance.capacity = cordeau.limits[0].capacity;
+    instance.max_duration = cordeau.limits[0].max_duration;
+    instance.customers.push_back({0, cordeau.depots[0].x, cordeau.depots[0].y, 0, 0.0, {}});
+    for (const vrp::CordeauInstance::Customer& c : cordeau.customers) {
+        instance.customers.push_back({(int)instance.customers.size(), c.x, c.y, c.demand, c.service_time, c.patterns});
+    }
+    return instance;
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = vrp::seedArg(argc, argv, vrp::timeSeed());
+    vrp::Rng rng(seed);
+    vrp::ParallelOptions parallel = vrp::parallelOptionsFromArgs(argc, argv, 1000);
+    string instance_path = vrp::stringArg(argc, argv, "--instance", "");
+    double time_limit = vrp::doubleArg(argc, argv, "--time-limit", 0.0);
+    bool json = vrp::hasFlag(argc, argv, "--json");
+
+    PvrpInstance instance;
+    string instance_name = "random";
+    if (!instance_path.empty()) {
+        try {
+            vrp::CordeauInstance cordeau = vrp::loadCordeau(instance_path);
+            if (cordeau.type != 1) {
+                throw runtime_error(instance_path + " is not a PVRP instance");
+            }
+            instance_name = cordeau.name;
+            instance = load_instance(cordeau);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    } else {
+        instance = random_instance(rng);
+    }
+    instance.dist = vrp::DistanceMatrix::euclidean(instance.customers);
+
+    vrp::Stopwatch stopwatch;
+    SearchStats stats;
+    Plan plan = simulated_annealing(instance, time_limit, parallel, rng, stats);
+    double elapsed = stopwatch.seconds();
+
+    if (json) {
+        // plan.cost carries the overload and duration penalties; the report wants the distance.
+        double distance = 0.0;
+        bool feasible = true;
+        for (const DayRoutes& routes : plan.days) {
+            for (const vector<int>& route : routes) {
+                RouteStats route_stats = calculate_route_stats(route, instance);
+                distance += route_stats.distance;
+                feasible = feasible && route_stats.load <= instance.capacity &&
+                           (instance.max_duration <= 0 || route_stats.distance + route_stats.service <= instance.max_duration);
+            }
+        }
+        vrp::RunReport report;
+        report.solver = "pvrp";
+        report.instance = instance_name;
+        report.seed = seed;
+        report.chains = parallel.num_chains;
+        report.iterations = stats.iterations;
+        report.seconds = elapsed;
+        report.best_cost = distance;
+        report.feasible = feasible;
+        report.time_to_best = stats.time_to_best;
+        report.print();
+        return 0;
+    }
+
+    for (int day = 0; day < instance.days; ++day) {
+        cout << "Best solution found for Day " << day + 1 << ":" << endl;
+        for (int v = 0; v < instance.vehicles; ++v) {
             cout << "Vehicle " << v + 1 << ": ";
-            for (int i = 0; i < solution[v].size(); ++i) {
-                cout << solution[v][i] << " ";
+            for (int customer : plan.days[day][v]) {
+                cout << customer << " ";
             }
             cout << endl;
         }
-        double total_distance = 0.0;
-        for (int v = 0; v < NUM_VEHICLES; ++v) {
-            total_distance += calculate_route_distance(solution[v], customers);
-        }
-        cout << "Total Distance for Day " << period + 1 << ": " << total_distance << endl;
-        chrono::duration<double> elapsed_time = end_time - start_time;
-        cout << "Execution Time for Day " << period + 1 << ": " << elapsed_time.count() << " seconds" << endl;
+        cout << "Total Distance for Day " << day + 1 << ": " << plan.day_costs[day] << endl;
     }
+    cout << "Total Distance: " << plan.cost << endl;
+    cout << "Execution Time: " << elapsed << " seconds" << endl;
     return 0;
 }
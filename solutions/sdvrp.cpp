@@ -2,145 +2,465 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include <cstdlib>
-#include <ctime>
 #include <limits>
 #include <algorithm>
+#include <deque>
+#include "common/adaptive_schedule.h"
+#include "common/annealer.h"
+#include "common/anytime.h"
+#include "common/cli.h"
+#include "common/distance_matrix.h"
+#include "common/neighbor_lists.h"
+#include "common/parallel_annealing.h"
+#include "common/rng.h"
+#include "common/thread_pool.h"
 
 using namespace std;
 
 const int NUM_CUSTOMERS = 50;
-const int NUM_VEHICLES = 10;
 const int VEHICLE_CAPACITY = 100;
-const double COOLING_RATE = 0.99;
-const double INITIAL_TEMPERATURE = 1000.0;
-const int MAX_ITERATIONS = 10000;
+const int MAX_DEMAND = 70;     // bulk orders, so many customers fill most of a vehicle
+const int SPARE_VEHICLES = 1;  // fleet beyond the ceil(total demand / capacity) minimum
+const double INITIAL_TEMPERATURE = 1000.0;  // replaced by calibration when a sampled move goes uphill
+const int MAX_ITERATIONS = 200000;
+const int NEIGHBOR_LIST_SIZE = 10;
+const int RESYNC_INTERVAL = 1000;
 
 struct Customer {
     int demand;
     int x, y;
 };
 
-vector<Customer> customers(NUM_CUSTOMERS);
-vector<vector<int>> routes(NUM_VEHICLES);
-vector<int> vehicle_capacity(NUM_VEHICLES, VEHICLE_CAPACITY);
+// One stop of a route: `quantity` of the customer's demand is delivered there. A customer
+// may be served by several routes, at most once by each, and its visits add up to its demand.
+struct Visit {
+    int customer;
+    int quantity;
+};
 
-double distance(int i, int j) {
-    return sqrt(pow(customers[i].x - customers[j].x, 2) + pow(customers[i].y - customers[j].y, 2));
-}
+// Where one of a customer's visits sits.
+struct VisitRef {
+    int route;
+    int index;
+};
 
-void generate_initial_solution() {
-    vector<int> unvisited_customers(NUM_CUSTOMERS);
-    for (int i = 0; i < NUM_CUSTOMERS; ++i) {
-        unvisited_customers[i] = i;
+// Everything one solve touches: the instance, its distance matrix and neighbour lists, the
+// routes being annealed with their cached loads, and the random stream. Nothing in this
+// file is shared between contexts, so independent instances can be solved side by side on
+// a thread pool.
+struct SolverContext {
+    vector<Customer> customers;  // the depot is customers[0], with no demand
+    int num_vehicles = 0;
+    vector<vector<Visit>> routes;
+    vector<int> loads;
+    vector<vector<VisitRef>> visits_of;  // by customer
+    vrp::DistanceMatrix distance_matrix;
+    vrp::NeighborLists neighbors;
+    vrp::Rng rng;
+
+    vector<vector<Visit>> best_routes;
+    double best_distance = numeric_limits<double>::max();
+
+    // A random instance drawn from `rng`, which the context then keeps for the search. The
+    // fleet is the smallest one that can carry the total demand, which split deliveries
+    // always make feasible, plus SPARE_VEHICLES.
+    explicit SolverContext(vrp::Rng rng) : customers(NUM_CUSTOMERS + 1), rng(rng) {
+        int total_demand = 0;
+        for (int i = 0; i <= NUM_CUSTOMERS; ++i) {
+            customers[i].demand = i == 0 ? 0 : this->rng.uniformInt(MAX_DEMAND) + 1;
+            customers[i].x = this->rng.uniformInt(100);
+            customers[i].y = this->rng.uniformInt(100);
+            total_demand += customers[i].demand;
+        }
+        num_vehicles = (total_demand + VEHICLE_CAPACITY - 1) / VEHICLE_CAPACITY + SPARE_VEHICLES;
+        distance_matrix = vrp::DistanceMatrix::euclidean(customers);
+        neighbors = vrp::NeighborLists::build(customers, NEIGHBOR_LIST_SIZE, 1);
     }
 
-    sort(unvisited_customers.begin(), unvisited_customers.end(), [](int a, int b) {
-        return customers[a].demand > customers[b].demand;
-    });
+    double distance(int i, int j) const { return distance_matrix(i, j); }
+
+    // Customer before position k of route r and the one at position k, the depot past the
+    // ends.
+    int customerBefore(int r, int k) const { return k == 0 ? 0 : routes[r][k - 1].customer; }
+    int customerAt(int r, int k) const { return k == (int)routes[r].size() ? 0 : routes[r][k].customer; }
+
+    // Cost change of dropping the visit at position k of route r, or of adding `customer`
+    // in front of position k.
+    double removalDelta(int r, int k) const {
+        int before = customerBefore(r, k);
+        int after = customerAt(r, k + 1);
+        int customer = routes[r][k].customer;
+        return distance(before, after) - distance(before, customer) - distance(customer, after);
+    }
+
+    double insertionDelta(int customer, int r, int k) const {
+        int before = customerBefore(r, k);
+        int after = customerAt(r, k);
+        return distance(before, customer) + distance(customer, after) - distance(before, after);
+    }
+
+    // The position of `customer` on route r, or -1. Customers are split over few routes,
+    // so this is O(1) in practice.
+    int indexOn(int customer, int r) const {
+        for (const VisitRef& ref : visits_of[customer]) {
+            if (ref.route == r) {
+                return ref.index;
+            }
+        }
+        return -1;
+    }
+
+    // Recomputes the loads and visit positions of every route.
+    void rebuildCaches() {
+        loads.assign(num_vehicles, 0);
+        visits_of.assign(customers.size(), {});
+        for (int r = 0; r < num_vehicles; ++r) {
+            reindexRoute(r);
+        }
+    }
+
+    // Recomputes the load of route r and the positions of its visits after it changed.
+    void reindexRoute(int r) {
+        loads[r] = 0;
+        for (int k = 0; k < (int)routes[r].size(); ++k) {
+            const Visit& visit = routes[r][k];
+            loads[r] += visit.quantity;
+            vector<VisitRef>& refs = visits_of[visit.customer];
+            auto ref = find_if(refs.begin(), refs.end(), [r](const VisitRef& v) { return v.route == r; });
+            if (ref == refs.end()) {
+                refs.push_back({r, k});
+            } else {
+                ref->index = k;
+            }
+        }
+    }
+
+    // Drops the visit of `customer` on route r from visits_of; the route itself is the
+    // caller's to change.
+    void forgetVisit(int customer, int r) {
+        vector<VisitRef>& refs = visits_of[customer];
+        refs.erase(find_if(refs.begin(), refs.end(), [r](const VisitRef& v) { return v.route == r; }));
+    }
+};
+
+// Largest demands first, each appended to the route it lengthens least among those with
+// room left. A customer that does not fit whole fills that route and the rest of its
+// demand goes to the next cheapest one, so no customer is ever dropped: the fleet can
+// carry the total demand.
+void generate_initial_solution(SolverContext& context) {
+    const vector<Customer>& customers = context.customers;
+    context.routes.assign(context.num_vehicles, {});
+    context.loads.assign(context.num_vehicles, 0);
 
+    vector<int> order(NUM_CUSTOMERS);
     for (int i = 0; i < NUM_CUSTOMERS; ++i) {
-        int customer = unvisited_customers[i];
-        int min_route_index = -1;
-        double min_increase_cost = numeric_limits<double>::max();
-
-        for (int v = 0; v < NUM_VEHICLES; ++v) {
-            if (vehicle_capacity[v] >= customers[customer].demand) {
-                double increase_cost = 0.0;
-                if (!routes[v].empty()) {
-                    increase_cost += distance(routes[v].back(), customer);
-                    increase_cost += distance(customer, 0);
-                } else {
-                    increase_cost += distance(0, customer);
-                    increase_cost += distance(customer, 0);
-                }
+        order[i] = i + 1;
+    }
+    sort(order.begin(), order.end(), [&customers](int a, int b) {
+        return customers[a].demand > customers[b].demand;
+    });
 
-                if (increase_cost < min_increase_cost) {
-                    min_increase_cost = increase_cost;
-                    min_route_index = v;
+    for (int customer : order) {
+        int remaining = customers[customer].demand;
+        while (remaining > 0) {
+            int min_route_index = -1;
+            double min_increase_cost = numeric_limits<double>::max();
+            for (int v = 0; v < context.num_vehicles; ++v) {
+                if (context.loads[v] < VEHICLE_CAPACITY) {
+                    double increase_cost = context.insertionDelta(customer, v, context.routes[v].size());
+                    if (increase_cost < min_increase_cost) {
+                        min_increase_cost = increase_cost;
+                        min_route_index = v;
+                    }
                 }
             }
-        }
 
-        if (min_route_index != -1) {
-            routes[min_route_index].push_back(customer);
-            vehicle_capacity[min_route_index] -= customers[customer].demand;
+            int quantity = min(remaining, VEHICLE_CAPACITY - context.loads[min_route_index]);
+            context.routes[min_route_index].push_back({customer, quantity});
+            context.loads[min_route_index] += quantity;
+            remaining -= quantity;
         }
     }
+    context.rebuildCaches();
 }
 
-double evaluate_solution() {
+double evaluate_solution(const SolverContext& context) {
     double total_distance = 0.0;
-    for (int v = 0; v < NUM_VEHICLES; ++v) {
-        if (!routes[v].empty()) {
-            total_distance += distance(0, routes[v][0]);
-            for (int i = 0; i < routes[v].size() - 1; ++i) {
-                total_distance += distance(routes[v][i], routes[v][i + 1]);
-            }
-            total_distance += distance(routes[v].back(), 0);
+    for (const vector<Visit>& route : context.routes) {
+        int previous = 0;
+        for (const Visit& visit : route) {
+            total_distance += context.distance(previous, visit.customer);
+            previous = visit.customer;
         }
+        total_distance += context.distance(previous, 0);
     }
     return total_distance;
 }
 
-void simulated_annealing() {
-    double temperature = INITIAL_TEMPERATURE;
-    double current_distance = evaluate_solution();
-    double best_distance = current_distance;
-    vector<vector<int>> best_solution = routes;
+// All four moves take `quantity` from the visit at (from_route, from_index):
+//   SWAP      exchanges it with the visit at (to_route, to_index), each keeping its quantity
+//   SPLIT     delivers `quantity` of it from a new visit inserted in front of position
+//             to_index of to_route; taking the whole visit relocates it
+//   MERGE     adds all of it to the same customer's visit at (to_route, to_index)
+//   TRANSFER  shifts part of it to the same customer's visit at (to_route, to_index)
+// Routes differ, and each is priced from the arcs around the touched positions and
+// checked against the cached loads in O(1).
+struct SdvrpMove {
+    static constexpr const char* kOperators[] = {"swap", "split", "merge", "transfer"};  // for telemetry, by kind
+    int operatorIndex() const { return kind; }
 
-    for (int iter = 0; iter < MAX_ITERATIONS; ++iter) {
-        int v1 = rand() % NUM_VEHICLES;
-        int v2 = rand() % NUM_VEHICLES;
+    enum Kind { SWAP, SPLIT, MERGE, TRANSFER } kind;
+    int from_route, from_index;
+    int to_route, to_index;
+    int quantity;
+    double priced_delta = 0.0;  // evaluate()'s result, kept for commit
+};
 
-        if (v1 != v2 && !routes[v1].empty() && !routes[v2].empty()) {
-            int idx1 = rand() % routes[v1].size();
-            int idx2 = rand() % routes[v2].size();
+struct SdvrpProblem {
+    using Solution = vector<vector<Visit>>;
 
-            int temp_customer = routes[v1][idx1];
-            routes[v1][idx1] = routes[v2][idx2];
-            routes[v2][idx2] = temp_customer;
+    SolverContext* context;
+    double current_distance;
 
-            double new_distance = evaluate_solution();
+    explicit SdvrpProblem(SolverContext& context) : context(&context) { resync(); }
+    SdvrpProblem(const SdvrpProblem&) = delete;
+    SdvrpProblem(SdvrpProblem&&) = default;
+    SdvrpProblem& operator=(SdvrpProblem&&) = default;
 
-            if (new_distance < current_distance || exp((current_distance - new_distance) / temperature) > ((double)rand() / RAND_MAX)) {
-                current_distance = new_distance;
-                if (current_distance < best_distance) {
-                    best_distance = current_distance;
-                    best_solution = routes;
-                }
+    double cost() const { return current_distance; }
+    const Solution& solution() const { return context->routes; }
+
+    void load(const Solution& solution) {
+        context->routes = solution;
+        context->rebuildCaches();
+        resync();
+    }
+
+    // Draws a visit, then either moves quantity to another visit of the same customer or
+    // pairs it with a visit of one of the customer's nearest neighbours, to swap with or to
+    // split next to.
+    bool propose(SdvrpMove& move, vrp::Rng& rng) {
+        const SolverContext& c = *context;
+        move.from_route = rng.uniformInt(c.num_vehicles);
+        const vector<Visit>& from = c.routes[move.from_route];
+        if (from.empty()) {
+            return false;
+        }
+        move.from_index = rng.uniformInt(from.size());
+        const Visit& visit = from[move.from_index];
+
+        const vector<VisitRef>& own = c.visits_of[visit.customer];
+        if (own.size() > 1 && rng.uniformInt(2) == 0) {
+            const VisitRef& other = own[rng.uniformInt(own.size())];
+            if (other.route == move.from_route) {
+                return false;
+            }
+            move.to_route = other.route;
+            move.to_index = other.index;
+            int room = VEHICLE_CAPACITY - c.loads[move.to_route];
+            if (visit.quantity <= room && rng.uniformInt(2) == 0) {
+                move.kind = SdvrpMove::MERGE;
+                move.quantity = visit.quantity;
+                return true;
+            }
+            move.kind = SdvrpMove::TRANSFER;
+            int most = min(visit.quantity - 1, room);
+            if (most <= 0) {
+                return false;
+            }
+            move.quantity = 1 + rng.uniformInt(most);
+            return true;
+        }
+
+        if (c.neighbors.k() == 0) {
+            return false;
+        }
+        int partner = c.neighbors.of(visit.customer)[rng.uniformInt(c.neighbors.k())];
+        const vector<VisitRef>& partner_visits = c.visits_of[partner];
+        const VisitRef& target = partner_visits[rng.uniformInt(partner_visits.size())];
+        if (target.route == move.from_route || c.indexOn(visit.customer, target.route) != -1) {
+            return false;
+        }
+        move.to_route = target.route;
+        int room = VEHICLE_CAPACITY - c.loads[move.to_route];
+
+        if (rng.uniformInt(2) == 0) {
+            const Visit& other = c.routes[target.route][target.index];
+            move.kind = SdvrpMove::SWAP;
+            move.to_index = target.index;
+            move.quantity = visit.quantity;
+            return c.indexOn(other.customer, move.from_route) == -1
+                && visit.quantity - other.quantity <= room
+                && other.quantity - visit.quantity <= VEHICLE_CAPACITY - c.loads[move.from_route];
+        }
+
+        move.kind = SdvrpMove::SPLIT;
+        move.to_index = target.index + rng.uniformInt(2);
+        int most = min(visit.quantity, room);
+        if (most <= 0) {
+            return false;
+        }
+        // Whole relocations half the time, otherwise a random part.
+        move.quantity = (visit.quantity <= room && rng.uniformInt(2) == 0) ? visit.quantity : 1 + rng.uniformInt(most);
+        return true;
+    }
+
+    double evaluate(SdvrpMove& move) {
+        move.priced_delta = delta(move);
+        return move.priced_delta;
+    }
+
+    void commit(SdvrpMove& move) {
+        current_distance += move.priced_delta;
+        SolverContext& c = *context;
+        vector<Visit>& from = c.routes[move.from_route];
+        vector<Visit>& to = c.routes[move.to_route];
+        Visit& visit = from[move.from_index];
+        int customer = visit.customer;
+
+        if (move.kind == SdvrpMove::SWAP) {
+            c.forgetVisit(customer, move.from_route);
+            c.forgetVisit(to[move.to_index].customer, move.to_route);
+            swap(visit, to[move.to_index]);
+        } else {
+            visit.quantity -= move.quantity;
+            if (move.kind == SdvrpMove::SPLIT) {
+                to.insert(to.begin() + move.to_index, {customer, move.quantity});
             } else {
-                temp_customer = routes[v1][idx1];
-                routes[v1][idx1] = routes[v2][idx2];
-                routes[v2][idx2] = temp_customer;
+                to[move.to_index].quantity += move.quantity;
+            }
+            if (visit.quantity == 0) {
+                c.forgetVisit(customer, move.from_route);
+                from.erase(from.begin() + move.from_index);
             }
         }
+        c.reindexRoute(move.from_route);
+        c.reindexRoute(move.to_route);
+    }
+
+    void revert(SdvrpMove&) {}
+
+    void resync() {
+        context->rebuildCaches();
+        current_distance = evaluate_solution(*context);
+    }
+
+private:
+    // Cost change of the move, from the arcs around the positions it touches.
+    double delta(const SdvrpMove& move) const {
+        const SolverContext& c = *context;
+        const Visit& visit = c.routes[move.from_route][move.from_index];
+        bool emptied = move.quantity == visit.quantity;
+        switch (move.kind) {
+        case SdvrpMove::SWAP: {
+            int other = c.routes[move.to_route][move.to_index].customer;
+            return replacementDelta(move.from_route, move.from_index, other)
+                 + replacementDelta(move.to_route, move.to_index, visit.customer);
+        }
+        case SdvrpMove::SPLIT:
+            return c.insertionDelta(visit.customer, move.to_route, move.to_index)
+                 + (emptied ? c.removalDelta(move.from_route, move.from_index) : 0.0);
+        case SdvrpMove::MERGE:
+            return c.removalDelta(move.from_route, move.from_index);
+        case SdvrpMove::TRANSFER:
+            return 0.0;
+        }
+        return 0.0;
+    }
+
+    // Cost change of putting `customer` in place of the visit at position k of route r.
+    double replacementDelta(int r, int k, int customer) const {
+        const SolverContext& c = *context;
+        int before = c.customerBefore(r, k);
+        int after = c.customerAt(r, k + 1);
+        int old = c.routes[r][k].customer;
+        return c.distance(before, customer) + c.distance(customer, after) - c.distance(before, old) - c.distance(old, after);
+    }
+};
 
-        temperature *= COOLING_RATE;
+// Anneals parallel.num_chains chains until MAX_ITERATIONS or the deadline, leaving the best
+// found in the context. The routes and their caches are a chain's state, so each chain
+// works in its own copy of the context, with its own initial routes. The trace numbers the
+// chains of `instance` from instance * parallel.num_chains.
+void simulated_annealing(SolverContext& context, const vrp::AnytimeOptions& anytime, vrp::ProgressStream& progress,
+                         vrp::TraceWriter& trace, const vrp::ParallelOptions& parallel, int instance) {
+    using Annealer = vrp::Annealer<SdvrpProblem, SdvrpMove, vrp::AdaptiveSchedule>;
+    Annealer::Options options;
+    options.resync_interval = RESYNC_INTERVAL;
+    anytime.configure(options, progress);
+    vrp::AdaptiveScheduleOptions schedule = vrp::AdaptiveScheduleOptions::budget(MAX_ITERATIONS, anytime.deadline.remaining());
+    deque<SolverContext> chain_contexts;  // stable addresses for the problems
+    vector<Annealer> chains;
+    for (int i = 0; i < parallel.num_chains; ++i) {
+        SolverContext& chain_context = chain_contexts.emplace_back(context);
+        chain_context.rng = context.rng.split();
+        generate_initial_solution(chain_context);
+        trace.configure(options, instance * parallel.num_chains + i);
+        chains.emplace_back(SdvrpProblem(chain_context), vrp::AdaptiveSchedule(INITIAL_TEMPERATURE, schedule),
+                            chain_context.rng.split(), options);
+        chains.back().calibrateTemperature(schedule.initial_acceptance);
     }
+    int best_chain = vrp::runChains(chains, anytime.iterationBudget(MAX_ITERATIONS), parallel, context.rng);
+
+    context.best_distance = chains[best_chain].bestCost();
+    context.best_routes = chains[best_chain].best();
+}
 
-    cout << "Best distance found: " << best_distance << endl;
+// Visits print as customer:quantity.
+void print_solution(const SolverContext& context) {
+    int used = 0;
+    vector<int> visits(context.customers.size(), 0);
+    for (const vector<Visit>& route : context.best_routes) {
+        used += !route.empty();
+        for (const Visit& visit : route) {
+            ++visits[visit.customer];
+        }
+    }
+    cout << "Best distance found: " << context.best_distance << endl;
+    cout << "Vehicles used: " << used << " of " << context.num_vehicles << ", split customers: "
+         << count_if(visits.begin(), visits.end(), [](int n) { return n > 1; }) << endl;
     cout << "Best solution: " << endl;
-    for (int v = 0; v < NUM_VEHICLES; ++v) {
+    for (int v = 0; v < context.num_vehicles; ++v) {
         cout << "Route " << v << ": ";
-        for (int i = 0; i < best_solution[v].size(); ++i) {
-            cout << best_solution[v][i] << " ";
+        for (const Visit& visit : context.best_routes[v]) {
+            cout << visit.customer << ":" << visit.quantity << " ";
         }
         cout << endl;
     }
 }
 
-int main() {
-    srand(time(NULL));
-    for (int i = 0; i < NUM_CUSTOMERS; ++i) {
-        customers[i].demand = rand() % 10 + 1;
-        customers[i].x = rand() % 100;
-        customers[i].y = rand() % 100;
+// --instances N solves N independent random instances concurrently, one context each, and
+// --chains N runs N chains per instance. A --time-limit is one deadline that every instance
+// must meet.
+int main(int argc, char** argv) {
+    vrp::Rng rng(vrp::seedArg(argc, argv, vrp::timeSeed()));
+    vrp::AnytimeOptions anytime = vrp::anytimeOptionsFromArgs(argc, argv);
+    vrp::ParallelOptions parallel = vrp::parallelOptionsFromArgs(argc, argv, 10000);
+    int num_instances = max(1, vrp::intArg(argc, argv, "--instances", 1));
+
+    vector<SolverContext> contexts;
+    deque<vrp::ProgressStream> streams;
+    vrp::TraceWriter trace = vrp::traceFromArgs<SdvrpMove>(argc, argv);
+    contexts.reserve(num_instances);
+    for (int k = 0; k < num_instances; ++k) {
+        contexts.emplace_back(rng.split());
+        streams.emplace_back(num_instances > 1 ? k : -1);
     }
 
-    generate_initial_solution();
+    auto solve = [&](int k) { simulated_annealing(contexts[k], anytime, streams[k], trace, parallel, k); };
+    if (num_instances == 1) {
+        solve(0);
+    } else {
+        vrp::ThreadPool pool(min<unsigned>(num_instances, max(1u, thread::hardware_concurrency())));
+        pool.parallelFor(num_instances, solve);
+    }
 
-    simulated_annealing();
+    for (int k = 0; k < num_instances; ++k) {
+        if (num_instances > 1) {
+            cout << "Instance " << k << endl;
+        }
+        print_solution(contexts[k]);
+    }
 
     return 0;
 }
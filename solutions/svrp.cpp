@@ -1,142 +1,239 @@
 // Stochastic Vehicle Routing Problem (SVRP) 
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <cmath>
-#include <ctime>
-#include <cstdlib>
 #include <limits>
+#include "common/adaptive_schedule.h"
+#include "common/annealer.h"
+#include "common/anytime.h"
+#include "common/cli.h"
+#include "common/distance_matrix.h"
+#include "common/neighbor_lists.h"
+#include "common/parallel_annealing.h"
+#include "common/rng.h"
+#include "common/scenarios.h"
+#include "common/tokenizer.h"
 
 using namespace std;
 
 const int NUM_VEHICLES = 3;
 const int DEPOT_INDEX = 0;
+const int NEIGHBOR_LIST_SIZE = 10;
 const double INF = numeric_limits<double>::infinity();
+const double VEHICLE_CAPACITY = 100.0;
+const double DEFAULT_DEMAND_MEAN = 10.0;
+const double DEFAULT_DEMAND_CV = 0.3;  // standard deviation as a fraction of the mean
+const int DEFAULT_SCENARIOS = 1000;
 
 struct Customer {
     int x;
     int y;
+    double demand_mean;
+    double demand_stddev;
+};
+
+// Demand scenarios shared by every chain and every move, plus each customer's
+// depot round trip, the price of one restocking detour there.
+struct StochasticDemand {
+    vrp::DemandScenarios scenarios;
+    vector<float> round_trip;
+
+    StochasticDemand(const vector<Customer>& customers, const vrp::DistanceMatrix& dist, int num_scenarios, vrp::Rng& rng) {
+        vector<double> mean, stddev;
+        for (int i = 0; i < customers.size(); ++i) {
+            mean.push_back(customers[i].demand_mean);
+            stddev.push_back(customers[i].demand_stddev);
+            round_trip.push_back(2 * dist(DEPOT_INDEX, i));
+        }
+        mean[DEPOT_INDEX] = stddev[DEPOT_INDEX] = 0.0;
+        scenarios = vrp::DemandScenarios(mean, stddev, num_scenarios, VEHICLE_CAPACITY, rng);
+    }
+
+    double expectedRecourse(const vector<int>& route) const {
+        return scenarios.expectedRecourse(route.data(), route.size(), round_trip.data(), VEHICLE_CAPACITY);
+    }
 };
 
 struct Solution {
     vector<vector<int>> routes;
+    vector<double> route_costs;
+    vrp::RoutePositions positions;
     double cost;
 };
 
-double euclideanDistance(int x1, int y1, int x2, int y2) {
-    return sqrt(pow(x1 - x2, 2) + pow(y1 - y2, 2));
-}
-
+// First the customer count, then one line per customer: "x y", optionally followed by the
+// demand's mean and standard deviation. Customer 0 is the depot.
 vector<Customer> readCustomersFromFile(const string& filename) {
     vector<Customer> customers;
-    ifstream file(filename);
-    if (!file) {
-        cerr << "Error: Unable to open file " << filename << endl;
+    try {
+        vrp::MappedFile file(filename);
+        vrp::Tokenizer in(file.text());
+        customers.resize(in.expect<int>("customer count"));
+        in.line();
+        for (Customer& customer : customers) {
+            vrp::Tokenizer fields(in.nextLine());
+            customer.x = fields.expect<int>("x coordinate");
+            customer.y = fields.expect<int>("y coordinate");
+            if (!fields.next(customer.demand_mean)) {
+                customer.demand_mean = DEFAULT_DEMAND_MEAN;
+            }
+            if (!fields.next(customer.demand_stddev)) {
+                customer.demand_stddev = DEFAULT_DEMAND_CV * customer.demand_mean;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << filename << ": " << e.what() << endl;
         exit(1);
     }
+    return customers;
+}
 
-    int numCustomers;
-    file >> numCustomers;
-
-    customers.resize(numCustomers);
-
-    for (int i = 0; i < numCustomers; ++i) {
-        file >> customers[i].x >> customers[i].y;
+// Distance of the planned route plus the expected cost of its restocking detours.
+double routeCost(const vector<int>& route, const vrp::DistanceMatrix& dist, const StochasticDemand& demand) {
+    if (route.empty()) {
+        return 0.0;
     }
-
-    file.close();
-    return customers;
+    double cost = demand.expectedRecourse(route);
+    int prevNode = DEPOT_INDEX;
+    for (int i = 0; i < route.size(); ++i) {
+        int customer = route[i];
+        cost += dist(prevNode, customer);
+        prevNode = customer;
+    }
+    cost += dist(prevNode, DEPOT_INDEX);
+    return cost;
 }
 
-Solution generateInitialSolution(const vector<Customer>& customers) {
+Solution generateInitialSolution(const vector<Customer>& customers, const vrp::DistanceMatrix& dist, const StochasticDemand& demand,
+                                 vrp::Rng& rng) {
     Solution initialSolution;
     initialSolution.routes.resize(NUM_VEHICLES);
+    initialSolution.route_costs.resize(NUM_VEHICLES);
 
     for (int i = 1; i < customers.size(); ++i) {
-        int vehicle = rand() % NUM_VEHICLES;
+        int vehicle = rng.uniformInt(NUM_VEHICLES);
         initialSolution.routes[vehicle].push_back(i);
     }
 
+    initialSolution.positions.rebuild(initialSolution.routes, customers.size());
     initialSolution.cost = 0.0;
     for (int v = 0; v < NUM_VEHICLES; ++v) {
-        if (!initialSolution.routes[v].empty()) {
-            int prevNode = DEPOT_INDEX;
-            for (int i = 0; i < initialSolution.routes[v].size(); ++i) {
-                int customer = initialSolution.routes[v][i];
-                initialSolution.cost += euclideanDistance(customers[prevNode].x, customers[prevNode].y,
-                                                          customers[customer].x, customers[customer].y);
-                prevNode = customer;
-            }
-            initialSolution.cost += euclideanDistance(customers[prevNode].x, customers[prevNode].y,
-                                                      customers[DEPOT_INDEX].x, customers[DEPOT_INDEX].y);
-        }
+        initialSolution.route_costs[v] = routeCost(initialSolution.routes[v], dist, demand);
+        initialSolution.cost += initialSolution.route_costs[v];
     }
 
     return initialSolution;
 }
 
-Solution generateNeighborSolution(const Solution& currentSolution) {
-    Solution neighborSolution = currentSolution;
+// Swaps two customers between routes in place. apply() re-costs only the two touched
+// routes and keeps their old costs so undo() can restore the solution exactly.
+struct SwapMove {
+    static constexpr const char* kOperators[] = {"swap"};  // for telemetry
+    int operatorIndex() const { return 0; }
+
+    int vehicle1, customer1;
+    int vehicle2, customer2;
+    double oldCost1, oldCost2;
+
+    double apply(Solution& solution, const vrp::DistanceMatrix& dist, const StochasticDemand& demand) {
+        swapCustomers(solution);
+        oldCost1 = solution.route_costs[vehicle1];
+        oldCost2 = solution.route_costs[vehicle2];
+        solution.route_costs[vehicle1] = routeCost(solution.routes[vehicle1], dist, demand);
+        solution.route_costs[vehicle2] = routeCost(solution.routes[vehicle2], dist, demand);
+        double deltaCost = solution.route_costs[vehicle1] + solution.route_costs[vehicle2] - oldCost1 - oldCost2;
+        solution.cost += deltaCost;
+        return deltaCost;
+    }
 
-    int vehicle1 = rand() % NUM_VEHICLES;
-    int vehicle2 = rand() % NUM_VEHICLES;
-    while (vehicle1 == vehicle2) {
-        vehicle2 = rand() % NUM_VEHICLES;
+    void undo(Solution& solution) const {
+        swapCustomers(solution);
+        solution.cost += oldCost1 + oldCost2 - solution.route_costs[vehicle1] - solution.route_costs[vehicle2];
+        solution.route_costs[vehicle1] = oldCost1;
+        solution.route_costs[vehicle2] = oldCost2;
     }
 
-    if (!neighborSolution.routes[vehicle1].empty() && !neighborSolution.routes[vehicle2].empty()) {
-        int customer1 = rand() % neighborSolution.routes[vehicle1].size();
-        int customer2 = rand() % neighborSolution.routes[vehicle2].size();
+    void swapCustomers(Solution& solution) const {
+        swap(solution.routes[vehicle1][customer1], solution.routes[vehicle2][customer2]);
+        solution.positions.place(solution.routes[vehicle1][customer1], vehicle1, customer1);
+        solution.positions.place(solution.routes[vehicle2][customer2], vehicle2, customer2);
+    }
+};
 
-        int temp = neighborSolution.routes[vehicle1][customer1];
-        neighborSolution.routes[vehicle1][customer1] = neighborSolution.routes[vehicle2][customer2];
-        neighborSolution.routes[vehicle2][customer2] = temp;
+// The first customer is drawn uniformly, the second from its nearest-neighbour list; a
+// partner that already rides on the same vehicle gives no move.
+bool generateNeighborMove(const Solution& currentSolution, const vrp::NeighborLists& neighbors, SwapMove& move, vrp::Rng& rng) {
+    move.vehicle1 = rng.uniformInt(NUM_VEHICLES);
 
-        neighborSolution.cost = 0.0;
-        for (int v = 0; v < NUM_VEHICLES; ++v) {
-            if (!neighborSolution.routes[v].empty()) {
-                int prevNode = DEPOT_INDEX;
-                for (int i = 0; i < neighborSolution.routes[v].size(); ++i) {
-                    int customer = neighborSolution.routes[v][i];
-                    neighborSolution.cost += euclideanDistance(customers[prevNode].x, customers[prevNode].y,
-                                                               customers[customer].x, customers[customer].y);
-                    prevNode = customer;
-                }
-                neighborSolution.cost += euclideanDistance(customers[prevNode].x, customers[prevNode].y,
-                                                           customers[DEPOT_INDEX].x, customers[DEPOT_INDEX].y);
-            }
-        }
+    if (currentSolution.routes[move.vehicle1].empty() || neighbors.k() == 0) {
+        return false;
     }
 
-    return neighborSolution;
+    move.customer1 = rng.uniformInt(currentSolution.routes[move.vehicle1].size());
+    int partner = neighbors.of(currentSolution.routes[move.vehicle1][move.customer1])[rng.uniformInt(neighbors.k())];
+    move.vehicle2 = currentSolution.positions.route[partner];
+    move.customer2 = currentSolution.positions.index[partner];
+    return move.vehicle2 != move.vehicle1;
 }
 
-Solution simulatedAnnealing(const vector<Customer>& customers, double initialTemperature, double coolingRate, int iterations) {
-    Solution currentSolution = generateInitialSolution(customers);
-    Solution bestSolution = currentSolution;
+// The current solution, changed in place by swaps and restored on rejection.
+struct SvrpProblem {
+    using Solution = ::Solution;
 
-    double temperature = initialTemperature;
+    const vrp::DistanceMatrix* dist;
+    const vrp::NeighborLists* neighbors;
+    const StochasticDemand* demand;
+    Solution current;
 
-    for (int i = 0; i < iterations; ++i) {
-        Solution neighborSolution = generateNeighborSolution(currentSolution);
-        double deltaCost = neighborSolution.cost - currentSolution.cost;
+    SvrpProblem(const vrp::DistanceMatrix& dist, const vrp::NeighborLists& neighbors, const StochasticDemand& demand,
+                const Solution& initial)
+        : dist(&dist), neighbors(&neighbors), demand(&demand), current(initial) {}
 
-        if (deltaCost < 0 || exp(-deltaCost / temperature) > ((double) rand() / RAND_MAX)) {
-            currentSolution = neighborSolution;
-        }
+    double cost() const { return current.cost; }
+    const Solution& solution() const { return current; }
+    void load(const Solution& solution) { current = solution; }
 
-        if (currentSolution.cost < bestSolution.cost) {
-            bestSolution = currentSolution;
+    bool propose(SwapMove& move, vrp::Rng& rng) { return generateNeighborMove(current, *neighbors, move, rng); }
+    double evaluate(SwapMove& move) { return move.apply(current, *dist, *demand); }
+    void commit(SwapMove&) {}
+    void revert(SwapMove& move) { move.undo(current); }
+
+    void resync() {
+        current.cost = 0.0;
+        for (int v = 0; v < NUM_VEHICLES; ++v) {
+            current.route_costs[v] = routeCost(current.routes[v], *dist, *demand);
+            current.cost += current.route_costs[v];
         }
+    }
+};
 
-        temperature *= coolingRate;
+Solution simulatedAnnealing(const vector<Customer>& customers, const vrp::DistanceMatrix& dist, const vrp::NeighborLists& neighbors,
+                            const StochasticDemand& demand, double initialTemperature, int iterations,
+                            const vrp::AnytimeOptions& anytime, vrp::ProgressStream& progress, vrp::TraceWriter& trace,
+                            const vrp::ParallelOptions& parallel, vrp::Rng& rng) {
+    using Annealer = vrp::Annealer<SvrpProblem, SwapMove, vrp::AdaptiveSchedule>;
+    Annealer::Options options;
+    anytime.configure(options, progress);
+    vrp::AdaptiveScheduleOptions schedule = vrp::AdaptiveScheduleOptions::budget(iterations, anytime.deadline.remaining());
+    vector<Annealer> chains;
+    for (int i = 0; i < parallel.num_chains; ++i) {
+        vrp::Rng chainRng = rng.split();
+        SvrpProblem problem(dist, neighbors, demand, generateInitialSolution(customers, dist, demand, chainRng));
+        trace.configure(options, i);
+        chains.emplace_back(problem, vrp::AdaptiveSchedule(initialTemperature, schedule), chainRng, options);
+        chains.back().calibrateTemperature(schedule.initial_acceptance);
     }
+    int bestChain = vrp::runChains(chains, anytime.iterationBudget(iterations), parallel, rng);
 
-    return bestSolution;
+    return chains[bestChain].best();
 }
 
-void outputSolution(const Solution& bestSolution, const vector<Customer>& customers) {
-    cout << "Best Solution (Cost = " << bestSolution.cost << "):" << endl;
+void outputSolution(const Solution& bestSolution, const StochasticDemand& demand) {
+    double recourse = 0.0;
+    for (const vector<int>& route : bestSolution.routes) {
+        recourse += demand.expectedRecourse(route);
+    }
+    cout << "Best Solution (Cost = " << bestSolution.cost << ", expected recourse = " << recourse << "):" << endl;
     for (int v = 0; v < NUM_VEHICLES; ++v) {
         cout << "Vehicle " << v + 1 << ": ";
         for (int i = 0; i < bestSolution.routes[v].size(); ++i) {
@@ -161,19 +258,28 @@ void outputSolution(const Solution& bestSolution, const vector<Customer>& custom
     }
 }
 
-int main() {
-    srand(static_cast<unsigned int>(time(nullptr)));
+int main(int argc, char** argv) {
+    vrp::Rng rng(vrp::seedArg(argc, argv, vrp::timeSeed()));
+
+    vrp::ParallelOptions parallel = vrp::parallelOptionsFromArgs(argc, argv, 1000);
+    vrp::AnytimeOptions anytime = vrp::anytimeOptionsFromArgs(argc, argv);
+    vrp::ProgressStream progress;
+    vrp::TraceWriter trace = vrp::traceFromArgs<SwapMove>(argc, argv);
 
     string filename = "customers.txt";
     vector<Customer> customers = readCustomersFromFile(filename);
+    vrp::DistanceMatrix dist = vrp::DistanceMatrix::euclidean(customers);
+    vrp::NeighborLists neighbors = vrp::NeighborLists::build(customers, NEIGHBOR_LIST_SIZE, DEPOT_INDEX + 1);
+    vrp::Rng scenarioRng = rng.split();
+    StochasticDemand demand(customers, dist, vrp::intArg(argc, argv, "--scenarios", DEFAULT_SCENARIOS), scenarioRng);
 
     double initialTemperature = 1000;
-    double coolingRate = 0.95;
     int iterations = 10000;
 
-    Solution bestSolution = simulatedAnnealing(customers, initialTemperature, coolingRate, iterations);
+    Solution bestSolution = simulatedAnnealing(customers, dist, neighbors, demand, initialTemperature, iterations, anytime, progress,
+                                               trace, parallel, rng);
 
-    outputSolution(bestSolution, customers);
+    outputSolution(bestSolution, demand);
 
     return 0;
 }
@@ -2,17 +2,31 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include <cstdlib>
-#include <ctime>
 #include <limits>
 #include <algorithm>
+#include "common/adaptive_schedule.h"
+#include "common/annealer.h"
+#include "common/anytime.h"
+#include "common/cli.h"
+#include "common/distance_matrix.h"
+#include "common/parallel_annealing.h"
+#include "common/report.h"
+#include "common/rng.h"
+#include "common/time_dependent.h"
 
 using namespace std;
 
 const int MAX_ITER = 10000;
-const double INITIAL_TEMPERATURE = 100.0;
-const double FINAL_TEMPERATURE = 0.1;
-const double COOLING_RATE = 0.95;
+const double INITIAL_TEMPERATURE = 100.0;  // replaced by calibration when a sampled move goes uphill
+const double LATENESS_PENALTY = 10.0;  // per time unit past a node's due time
+const double BUCKET_LENGTH = 4.0;      // time-of-day bucket of the speed profiles
+
+// Speed factor per time-of-day bucket. Profile 0 is for outer arcs, profile 1 for arcs
+// through the centre, which slow down much more in the two rush hours.
+const vector<vector<double>> SPEED_PROFILES = {
+    {1.0, 0.8, 0.9, 0.8, 1.0},
+    {1.0, 0.5, 0.8, 0.5, 1.0},
+};
 
 struct Node {
     int id;
@@ -24,13 +38,18 @@ struct Node {
     double service_time;
 };
 
-struct TimeMatrix {
-    vector<vector<double>> travel_time;
+// Arrival and departure time at each stop of a route and the cost accumulated up to it,
+// so that a change can be re-timed from the first touched stop onwards.
+struct RouteSchedule {
+    vector<double> arrival;
+    vector<double> departure;
+    vector<double> prefix_cost;  // travel time plus lateness penalty up to and including the stop
+    double cost = 0.0;           // the whole route, back to the depot
 };
 
 struct Solution {
     vector<vector<int>> routes;
-    vector<double> arrival_times;
+    vector<RouteSchedule> schedules;
     double total_cost;
 };
 
@@ -38,42 +57,112 @@ double distance(const Node& n1, const Node& n2) {
     return sqrt(pow(n1.x - n2.x, 2) + pow(n1.y - n2.y, 2));
 }
 
-double travelTime(const Node& n1, const Node& n2, const TimeMatrix& time_matrix) {
-    return time_matrix.travel_time[n1.id][n2.id];
+// Arcs whose midpoint lies closer to the centre of the instance than the average node
+// use the congested profile.
+vrp::TimeDependentTravel buildTravelModel(const vector<Node>& nodes) {
+    vrp::TimeDependentTravel travel(vrp::DistanceMatrixF::euclidean(nodes), BUCKET_LENGTH, SPEED_PROFILES);
+    int n = nodes.size();
+    Node centre = {0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    for (const Node& node : nodes) {
+        centre.x += node.x / n;
+        centre.y += node.y / n;
+    }
+    double radius = 0.0;
+    for (const Node& node : nodes) {
+        radius += distance(node, centre) / n;
+    }
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            Node midpoint = {0, (nodes[i].x + nodes[j].x) / 2, (nodes[i].y + nodes[j].y) / 2, 0.0, 0.0, 0.0, 0.0};
+            if (distance(midpoint, centre) < radius) {
+                travel.setProfile(i, j, 1);
+            }
+        }
+    }
+    return travel;
 }
 
-double calculateRouteTravelTime(const vector<int>& route, const vector<Node>& nodes, const TimeMatrix& time_matrix) {
-    double total_time = 0.0;
-    if (route.size() == 0)
-        return total_time;
-    
-    total_time += travelTime(nodes[0], nodes[route[0]], time_matrix);
+// Re-times `route` from position `from`, taking the earlier stops from `cached`, and writes
+// stops [from, end) into `out`. Stops after `last_changed` are the same as in `cached`, so
+// the first of them whose departure comes out unchanged ends the walk: the rest of the
+// route is timed exactly as before. Returns the route's cost.
+double retimeRoute(const vector<int>& route, const vector<Node>& nodes, const vrp::TimeDependentTravel& travel,
+                   const RouteSchedule& cached, int from, int last_changed, RouteSchedule& out, int& end) {
+    int m = route.size();
+    out.arrival.resize(m);
+    out.departure.resize(m);
+    out.prefix_cost.resize(m);
+    end = m;
+    if (m == 0) {
+        return 0.0;
+    }
 
-    for (size_t i = 0; i < route.size() - 1; ++i) {
-        total_time += travelTime(nodes[route[i]], nodes[route[i + 1]], time_matrix);
+    double time = from == 0 ? nodes[0].ready_time : cached.departure[from - 1];
+    double cost = from == 0 ? 0.0 : cached.prefix_cost[from - 1];
+    int prev = from == 0 ? 0 : route[from - 1];
+    for (int k = from; k < m; ++k) {
+        const Node& node = nodes[route[k]];
+        double arrival = travel.arrival(prev, node.id, time);
+        cost += arrival - time + LATENESS_PENALTY * max(0.0, arrival - node.due_time);
+        out.arrival[k] = arrival;
+        out.departure[k] = max(arrival, node.ready_time) + node.service_time;
+        out.prefix_cost[k] = cost;
+        if (k > last_changed && out.departure[k] == cached.departure[k]) {
+            end = k + 1;
+            return cost + cached.cost - cached.prefix_cost[k];
+        }
+        time = out.departure[k];
+        prev = node.id;
     }
 
-    total_time += travelTime(nodes[route.back()], nodes[0], time_matrix);
+    double arrival = travel.arrival(prev, 0, time);
+    return cost + arrival - time + LATENESS_PENALTY * max(0.0, arrival - nodes[0].due_time);
+}
+
+// Copies stops [from, end) of a re-timed schedule into the cached one. Later stops keep
+// their times but their accumulated cost moves by the same amount as stop end - 1's.
+void commitSchedule(RouteSchedule& cached, const RouteSchedule& retimed, int from, int end, double cost) {
+    int m = retimed.arrival.size();
+    if (cached.arrival.size() != m) {
+        cached = retimed;
+    } else {
+        double shift = end > from && end < m ? retimed.prefix_cost[end - 1] - cached.prefix_cost[end - 1] : 0.0;
+        for (int k = from; k < end; ++k) {
+            cached.arrival[k] = retimed.arrival[k];
+            cached.departure[k] = retimed.departure[k];
+            cached.prefix_cost[k] = retimed.prefix_cost[k];
+        }
+        for (int k = end; k < m; ++k) {
+            cached.prefix_cost[k] += shift;
+        }
+    }
+    cached.cost = cost;
+}
 
-    return total_time;
+RouteSchedule scheduleRoute(const vector<int>& route, const vector<Node>& nodes, const vrp::TimeDependentTravel& travel) {
+    RouteSchedule schedule;
+    int end;
+    schedule.cost = retimeRoute(route, nodes, travel, schedule, 0, route.size(), schedule, end);
+    return schedule;
 }
 
-double calculateTotalCost(const Solution& solution, const vector<Node>& nodes, const TimeMatrix& time_matrix) {
-    double total_cost = 0.0;
-    for (const auto& route : solution.routes) {
-        total_cost += calculateRouteTravelTime(route, nodes, time_matrix);
+void scheduleAll(Solution& solution, const vector<Node>& nodes, const vrp::TimeDependentTravel& travel) {
+    solution.schedules.resize(solution.routes.size());
+    solution.total_cost = 0.0;
+    for (size_t v = 0; v < solution.routes.size(); ++v) {
+        solution.schedules[v] = scheduleRoute(solution.routes[v], nodes, travel);
+        solution.total_cost += solution.schedules[v].cost;
     }
-    return total_cost;
 }
 
-Solution generateInitialSolution(const vector<Node>& nodes, int num_vehicles, const TimeMatrix& time_matrix) {
+Solution generateInitialSolution(const vector<Node>& nodes, int num_vehicles, const vrp::TimeDependentTravel& travel, vrp::Rng& rng) {
     Solution initial_solution;
     initial_solution.routes.resize(num_vehicles);
     vector<int> unassigned_nodes(nodes.size() - 1);
     for (size_t i = 1; i < nodes.size(); ++i) {
         unassigned_nodes[i - 1] = nodes[i].id;
     }
-    random_shuffle(unassigned_nodes.begin(), unassigned_nodes.end());
+    shuffle(unassigned_nodes.begin(), unassigned_nodes.end(), rng);
 
     int vehicle_idx = 0;
     for (size_t i = 0; i < unassigned_nodes.size(); ++i) {
@@ -81,107 +170,130 @@ Solution generateInitialSolution(const vector<Node>& nodes, int num_vehicles, co
         vehicle_idx = (vehicle_idx + 1) % num_vehicles;
     }
 
-    initial_solution.arrival_times.resize(nodes.size(), 0.0);
-    for (int v = 0; v < num_vehicles; ++v) {
-        double current_time = 0.0;
-        for (size_t i = 0; i < initial_solution.routes[v].size(); ++i) {
-            int node_id = initial_solution.routes[v][i];
-            current_time += travelTime(nodes[0], nodes[node_id], time_matrix);
-            initial_solution.arrival_times[node_id] = current_time;
-            current_time = max(current_time, nodes[node_id].ready_time) + nodes[node_id].service_time;
-        }
-        current_time += travelTime(nodes[initial_solution.routes[v].back()], nodes[0], time_matrix);
-        initial_solution.arrival_times[0] = current_time;
-    }
-
-    initial_solution.total_cost = calculateTotalCost(initial_solution, nodes, time_matrix);
+    scheduleAll(initial_solution, nodes, travel);
 
     return initial_solution;
 }
 
-Solution generateNeighborSolution(const Solution& current_solution, const vector<Node>& nodes, const TimeMatrix& time_matrix) {
-    Solution neighbor_solution = current_solution;
-
-    int route1 = rand() % neighbor_solution.routes.size();
-    int route2 = rand() % neighbor_solution.routes.size();
-    while (route1 == route2) {
-        route2 = rand() % neighbor_solution.routes.size();
+// Swaps two nodes between routes in place and re-times both routes from the swapped
+// positions into scratch schedules; commit() copies those into the solution and undo()
+// swaps back, leaving the cached schedules untouched.
+struct SwapMove {
+    static constexpr const char* kOperators[] = {"swap"};  // for telemetry
+    int operatorIndex() const { return 0; }
+
+    int route1, node1;
+    int route2, node2;
+    RouteSchedule retimed1, retimed2;
+    int end1, end2;
+    double cost1, cost2;
+
+    double apply(Solution& solution, const vector<Node>& nodes, const vrp::TimeDependentTravel& travel) {
+        swap(solution.routes[route1][node1], solution.routes[route2][node2]);
+        cost1 = retimeRoute(solution.routes[route1], nodes, travel, solution.schedules[route1], node1, node1, retimed1, end1);
+        cost2 = retimeRoute(solution.routes[route2], nodes, travel, solution.schedules[route2], node2, node2, retimed2, end2);
+        return cost1 + cost2 - solution.schedules[route1].cost - solution.schedules[route2].cost;
     }
 
-    if (neighbor_solution.routes[route1].size() > 0 && neighbor_solution.routes[route2].size() > 0) {
-        int node1 = rand() % neighbor_solution.routes[route1].size();
-        int node2 = rand() % neighbor_solution.routes[route2].size();
+    void commit(Solution& solution) const {
+        solution.total_cost += cost1 + cost2 - solution.schedules[route1].cost - solution.schedules[route2].cost;
+        commitSchedule(solution.schedules[route1], retimed1, node1, end1, cost1);
+        commitSchedule(solution.schedules[route2], retimed2, node2, end2, cost2);
+    }
 
-        int temp = neighbor_solution.routes[route1][node1];
-        neighbor_solution.routes[route1][node1] = neighbor_solution.routes[route2][node2];
-        neighbor_solution.routes[route2][node2] = temp;
+    void undo(Solution& solution) const {
+        swap(solution.routes[route1][node1], solution.routes[route2][node2]);
+    }
+};
 
-        neighbor_solution.arrival_times.resize(nodes.size(), 0.0);
-        for (int v = 0; v < neighbor_solution.routes.size(); ++v) {
-            double current_time = 0.0;
-            for (size_t i = 0; i < neighbor_solution.routes[v].size(); ++i) {
-                int node_id = neighbor_solution.routes[v][i];
-                current_time += travelTime(nodes[0], nodes[node_id], time_matrix);
-                neighbor_solution.arrival_times[node_id] = current_time;
-                current_time = max(current_time, nodes[node_id].ready_time) + nodes[node_id].service_time;
-            }
-            current_time += travelTime(nodes[neighbor_solution.routes[v].back()], nodes[0], time_matrix);
-            neighbor_solution.arrival_times[0] = current_time;
-        }
+// Swaps a stop between two different routes, so a single route has no moves.
+bool generateNeighborMove(const Solution& current_solution, SwapMove& move, vrp::Rng& rng) {
+    int num_routes = current_solution.routes.size();
+    if (num_routes < 2) {
+        return false;
+    }
+    move.route1 = rng.uniformInt(num_routes);
+    move.route2 = (move.route1 + 1 + rng.uniformInt(num_routes - 1)) % num_routes;
 
-        neighbor_solution.total_cost = calculateTotalCost(neighbor_solution, nodes, time_matrix);
+    if (current_solution.routes[move.route1].empty() || current_solution.routes[move.route2].empty()) {
+        return false;
     }
 
-    return neighbor_solution;
+    move.node1 = rng.uniformInt(current_solution.routes[move.route1].size());
+    move.node2 = rng.uniformInt(current_solution.routes[move.route2].size());
+    return true;
 }
 
-Solution simulatedAnnealing(const vector<Node>& nodes, int num_vehicles, const TimeMatrix& time_matrix) {
-    Solution current_solution = generateInitialSolution(nodes, num_vehicles, time_matrix);
-    Solution best_solution = current_solution;
+// The current solution, changed in place by swaps and restored on rejection.
+struct TdvrptwProblem {
+    using Solution = ::Solution;
 
-    double temperature = INITIAL_TEMPERATURE;
+    const vector<Node>* nodes;
+    const vrp::TimeDependentTravel* travel;
+    Solution current;
 
-    int iteration = 0;
-    while (temperature > FINAL_TEMPERATURE && iteration < MAX_ITER) {
-        Solution neighbor_solution = generateNeighborSolution(current_solution, nodes, time_matrix);
+    TdvrptwProblem(const vector<Node>& nodes, const vrp::TimeDependentTravel& travel, const Solution& initial)
+        : nodes(&nodes), travel(&travel), current(initial) {}
 
-        double current_cost = current_solution.total_cost;
-        double neighbor_cost = neighbor_solution.total_cost;
-        double cost_difference = neighbor_cost - current_cost;
+    double cost() const { return current.total_cost; }
+    const Solution& solution() const { return current; }
+    void load(const Solution& solution) { current = solution; }
 
-        if (cost_difference < 0 || exp(-cost_difference / temperature) > (rand() / (RAND_MAX + 1.0))) {
-            current_solution = neighbor_solution;
-            if (current_solution.total_cost < best_solution.total_cost) {
-                best_solution = current_solution;
-            }
-        }
-
-        temperature *= COOLING_RATE;
+    bool propose(SwapMove& move, vrp::Rng& rng) { return generateNeighborMove(current, move, rng); }
+    double evaluate(SwapMove& move) { return move.apply(current, *nodes, *travel); }
+    void commit(SwapMove& move) { move.commit(current); }
+    void revert(SwapMove& move) { move.undo(current); }
+    void resync() { scheduleAll(current, *nodes, *travel); }
+};
 
-        iteration++;
+using TdvrptwAnnealer = vrp::Annealer<TdvrptwProblem, SwapMove, vrp::AdaptiveSchedule>;
+
+// Every chain cools from a calibrated start over the whole MAX_ITER budget, or until the
+// deadline when there is one. Returns the index of the chain holding the best solution.
+int simulatedAnnealing(vector<TdvrptwAnnealer>& chains, const vector<Node>& nodes, int num_vehicles,
+                       const vrp::TimeDependentTravel& travel, const vrp::AnytimeOptions& anytime,
+                       vrp::ProgressStream& progress, vrp::TraceWriter& trace, const vrp::ParallelOptions& parallel,
+                       vrp::Rng& rng) {
+    TdvrptwAnnealer::Options options;
+    anytime.configure(options, progress);
+    vrp::AdaptiveScheduleOptions schedule = vrp::AdaptiveScheduleOptions::budget(MAX_ITER, anytime.deadline.remaining());
+    for (int i = 0; i < parallel.num_chains; ++i) {
+        vrp::Rng chain_rng = rng.split();
+        TdvrptwProblem problem(nodes, travel, generateInitialSolution(nodes, num_vehicles, travel, chain_rng));
+        trace.configure(options, i);
+        chains.emplace_back(problem, vrp::AdaptiveSchedule(INITIAL_TEMPERATURE, schedule), chain_rng, options);
+        chains.back().calibrateTemperature(schedule.initial_acceptance);
     }
-
-    return best_solution;
+    return vrp::runChains(chains, anytime.iterationBudget(MAX_ITER), parallel, rng);
 }
 
-TimeMatrix initializeTimeMatrix(const vector<Node>& nodes) {
-    TimeMatrix time_matrix;
-    int n = nodes.size();
-    time_matrix.travel_time.resize(n, vector<double>(n, 0.0));
-
-    for (int i = 0; i < n; ++i) {
-        for (int j = 0; j < n; ++j) {
-            if (i != j) {
-                time_matrix.travel_time[i][j] = distance(nodes[i], nodes[j]);
-            }
+// Time past the due times over every stop of the solution and the returns to the depot.
+double totalLateness(const Solution& solution, const vector<Node>& nodes, const vrp::TimeDependentTravel& travel) {
+    double lateness = 0.0;
+    for (size_t r = 0; r < solution.routes.size(); ++r) {
+        const vector<int>& route = solution.routes[r];
+        const RouteSchedule& schedule = solution.schedules[r];
+        if (route.empty()) {
+            continue;
         }
+        for (size_t k = 0; k < route.size(); ++k) {
+            lateness += max(0.0, schedule.arrival[k] - nodes[route[k]].due_time);
+        }
+        double back = travel.arrival(route.back(), 0, schedule.departure.back());
+        lateness += max(0.0, back - nodes[0].due_time);
     }
-
-    return time_matrix;
+    return lateness;
 }
 
-int main() {
-    srand(time(0));
+int main(int argc, char** argv) {
+    uint64_t seed = vrp::seedArg(argc, argv, vrp::timeSeed());
+    vrp::Rng rng(seed);
+
+    vrp::ParallelOptions parallel = vrp::parallelOptionsFromArgs(argc, argv, 50);
+    vrp::AnytimeOptions anytime = vrp::anytimeOptionsFromArgs(argc, argv);
+    vrp::ProgressStream progress;
+    vrp::TraceWriter trace = vrp::traceFromArgs<SwapMove>(argc, argv);  // outlives the chains, which flush into it
+    bool json = vrp::hasFlag(argc, argv, "--json");
 
     vector<Node> nodes = {
         {0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
@@ -194,9 +306,27 @@ int main() {
 
     int num_vehicles = 2;
 
-    TimeMatrix time_matrix = initializeTimeMatrix(nodes);
-
-    Solution best_solution = simulatedAnnealing(nodes, num_vehicles, time_matrix);
+    vrp::TimeDependentTravel travel = buildTravelModel(nodes);
+
+    vector<TdvrptwAnnealer> chains;
+    vrp::Stopwatch stopwatch;
+    int best_chain = simulatedAnnealing(chains, nodes, num_vehicles, travel, anytime, progress, trace, parallel, rng);
+    double elapsed = stopwatch.seconds();
+    const Solution& best_solution = chains[best_chain].best();
+
+    if (json) {
+        // The objective is travel time plus the lateness penalty; the report wants the travel time.
+        double lateness = totalLateness(best_solution, nodes, travel);
+        vrp::RunReport report;
+        report.solver = "tdvrptw";
+        report.instance = "example";
+        report.seed = seed;
+        report.collect(chains, best_chain, elapsed);
+        report.best_cost = best_solution.total_cost - LATENESS_PENALTY * lateness;
+        report.feasible = lateness == 0.0;
+        report.print();
+        return 0;
+    }
 
     cout << "Best solution:" << endl;
     cout << "Total cost: " << best_solution.total_cost << endl;
@@ -204,7 +334,7 @@ int main() {
     for (size_t i = 0; i < best_solution.routes.size(); ++i) {
         cout << "Route " << i + 1 << ": ";
         for (size_t j = 0; j < best_solution.routes[i].size(); ++j) {
-            cout << best_solution.routes[i][j] << " ";
+            cout << best_solution.routes[i][j] << " (arrives " << best_solution.schedules[i].arrival[j] << ") ";
         }
         cout << endl;
     }
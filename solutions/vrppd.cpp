@@ -2,202 +2,522 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include <cstdlib>
-#include <ctime>
 #include <limits>
 #include <algorithm>
+#include <functional>
+#include <deque>
+#include "common/adaptive_schedule.h"
+#include "common/annealer.h"
+#include "common/anytime.h"
+#include "common/distance_matrix.h"
+#include "common/cli.h"
+#include "common/parallel_annealing.h"
+#include "common/rng.h"
+#include "common/thread_pool.h"
 
 using namespace std;
 
 // Define constants for the problem
-const int NUM_CUSTOMERS = 10;   // Number of customers
+const int NUM_CUSTOMERS = 10;   // Number of customers, each one pickup/delivery pair
 const int NUM_VEHICLES = 3;     // Number of vehicles
+const int VEHICLE_CAPACITY = 30;
+const int MAX_DEMAND = 20;
+const double INITIAL_TEMPERATURE = 100.0;  // replaced by calibration when a sampled move goes uphill
+const long MAX_ITERATIONS = 1000000;       // per chain, without --time-limit
 
-// Define structures for points, customers, vehicles, and routes
+// Define structures for points, customers, nodes, vehicles, and routes
 struct Point {
     int x, y;
 };
 
-struct TimeWindow {
-    int start_time;
-    int end_time;
-};
-
 struct Customer {
     Point pickup;
     Point delivery;
-    TimeWindow time_window; // Time window for pickup
+    int demand;  // loaded at the pickup, unloaded at the delivery
+};
+
+// A row of the distance matrix. Depots come first, then every customer's pickup followed
+// by its delivery, so each stop of a route is its own node.
+struct Node {
+    Point location;
+    int demand;  // +q at a pickup, -q at a delivery, 0 at a depot
+    int pair;    // the other end of the shipment; -1 for depots
 };
 
+// Range minimum (or maximum, with std::greater) over an array, O(1) per query after an
+// O(n log n) build.
+template <typename Compare>
+class SparseTable {
+public:
+    void build(const vector<int>& values) {
+        int n = values.size();
+        int levels = 1;
+        while ((2 << (levels - 1)) <= n) {
+            ++levels;
+        }
+        levels_.resize(levels);
+        levels_[0] = values;
+        for (int k = 1; k < levels; ++k) {
+            int width = 1 << (k - 1);
+            const vector<int>& prev = levels_[k - 1];
+            vector<int>& cur = levels_[k];
+            cur.resize(n - 2 * width + 1);
+            for (size_t i = 0; i < cur.size(); ++i) {
+                cur[i] = best(prev[i], prev[i + width]);
+            }
+        }
+    }
+
+    // Best value in [begin, end); end > begin.
+    int query(int begin, int end) const {
+        int k = 31 - __builtin_clz(end - begin);
+        return best(levels_[k][begin], levels_[k][end - (1 << k)]);
+    }
+
+private:
+    static int best(int a, int b) { return Compare()(b, a) ? b : a; }
+
+    vector<vector<int>> levels_;
+};
+
+// load[k] is the load on board when the vehicle reaches position k (load[0] = 0 leaving
+// the depot, load[m] = 0 coming back). delivery_position[k] is where the pickup at
+// position k is delivered, or INT_MAX for a delivery. The range tables over both answer
+// every capacity and precedence question a move asks in O(1).
 struct Vehicle {
-    Point depot;
-    vector<int> route;  // Sequence of customer indices
+    int depot;          // row of the vehicle's depot in distance_matrix
+    vector<int> route;  // node ids
+    vector<int> load;
+    vector<int> delivery_position;
+    SparseTable<greater<int>> max_load;
+    SparseTable<less<int>> min_load;
+    SparseTable<less<int>> first_delivery;
 };
 
+// vehicle_of and position_of place every pickup and delivery node.
 struct Solution {
     vector<Vehicle> vehicles;
+    vector<int> vehicle_of;
+    vector<int> position_of;
     double cost;
 };
 
-// Global variables
-vector<Customer> customers(NUM_CUSTOMERS);
-vector<Point> depots(NUM_VEHICLES); // Each vehicle has a starting depot
-vector<TimeWindow> customer_time_windows(NUM_CUSTOMERS);
-Solution best_solution;
-double best_cost = numeric_limits<double>::max();
-vector<vector<double>> distance_matrix; // Distance matrix for all points
+// One instance and its search: the customers and depots, the node table and distance
+// matrix built from them, the random stream and the best solution found. Every function
+// below reads the instance through a context rather than file-scope state, so separate
+// contexts can be solved concurrently.
+struct SolverContext {
+    vector<Customer> customers;
+    vector<Point> depots;  // each vehicle has a starting depot
+    vector<Node> nodes;
+    vrp::DistanceMatrix distance_matrix;
+    vrp::Rng rng;
+    Solution best_solution;
+    double best_cost = numeric_limits<double>::max();
+
+    // A random instance drawn from `rng`, which the context then keeps for the search.
+    explicit SolverContext(vrp::Rng rng);
+};
 
-// Helper functions
-double distance(Point a, Point b) {
-    return sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+int pickup_node(int customer_idx) {
+    return NUM_VEHICLES + 2 * customer_idx;
 }
 
-void calculate_distance_matrix() {
-    int num_points = NUM_CUSTOMERS + NUM_VEHICLES;
-    distance_matrix.assign(num_points, vector<double>(num_points, 0.0));
+int delivery_node(int customer_idx) {
+    return NUM_VEHICLES + 2 * customer_idx + 1;
+}
 
-    for (int i = 0; i < NUM_VEHICLES; ++i) {
-        for (int j = 0; j < NUM_VEHICLES; ++j) {
-            if (i != j) {
-                distance_matrix[i][j] = distance(depots[i], depots[j]);
-            }
-        }
+bool is_pickup(int node) {
+    return node >= NUM_VEHICLES && (node - NUM_VEHICLES) % 2 == 0;
+}
+
+void build_nodes(SolverContext& context) {
+    const vector<Customer>& customers = context.customers;
+    vector<Node>& nodes = context.nodes;
+    nodes.clear();
+    for (int v = 0; v < NUM_VEHICLES; ++v) {
+        nodes.push_back({context.depots[v], 0, -1});
+    }
+    for (int c = 0; c < NUM_CUSTOMERS; ++c) {
+        nodes.push_back({customers[c].pickup, customers[c].demand, delivery_node(c)});
+        nodes.push_back({customers[c].delivery, -customers[c].demand, pickup_node(c)});
     }
 
-    for (int i = 0; i < NUM_VEHICLES; ++i) {
-        for (int j = 0; j < NUM_CUSTOMERS; ++j) {
-            distance_matrix[i][NUM_VEHICLES + j] = distance(depots[i], customers[j].pickup);
-            distance_matrix[NUM_VEHICLES + j][i] = distance(customers[j].delivery, depots[i]);
-        }
+    vector<Point> locations;
+    for (const Node& node : nodes) {
+        locations.push_back(node.location);
     }
+    context.distance_matrix = vrp::DistanceMatrix::euclidean(locations);
+}
 
-    for (int i = 0; i < NUM_CUSTOMERS; ++i) {
-        for (int j = 0; j < NUM_CUSTOMERS; ++j) {
-            if (i != j) {
-                distance_matrix[NUM_VEHICLES + i][NUM_VEHICLES + j] = distance(customers[i].delivery, customers[j].pickup);
-            }
-        }
+SolverContext::SolverContext(vrp::Rng rng) : customers(NUM_CUSTOMERS), depots(NUM_VEHICLES), rng(rng) {
+    for (Customer& customer : customers) {
+        customer.pickup.x = this->rng.uniformInt(100);
+        customer.pickup.y = this->rng.uniformInt(100);
+        customer.delivery.x = this->rng.uniformInt(100);
+        customer.delivery.y = this->rng.uniformInt(100);
+        customer.demand = 1 + this->rng.uniformInt(MAX_DEMAND);
+    }
+    for (Point& depot : depots) {
+        depot.x = this->rng.uniformInt(100);
+        depot.y = this->rng.uniformInt(100);
     }
+    build_nodes(*this);
 }
 
-double calculate_route_cost(const Vehicle& vehicle) {
-    double total_distance = 0.0;
-    Point current_location = vehicle.depot;
-    int current_time = 0;
+// Node before position k of a route and the node at position k, either being the depot
+// past the ends.
+int node_before(const Vehicle& vehicle, int k) {
+    return k == 0 ? vehicle.depot : vehicle.route[k - 1];
+}
 
-    for (int customer_idx : vehicle.route) {
-        total_distance += distance_matrix[current_location.x][current_location.y];
-        current_time += distance_matrix[current_location.x][current_location.y];
+int node_at(const Vehicle& vehicle, int k) {
+    return k == (int)vehicle.route.size() ? vehicle.depot : vehicle.route[k];
+}
 
-        if (current_time < customers[customer_idx].time_window.start_time) {
-            current_time = customers[customer_idx].time_window.start_time;
-        }
-        else if (current_time > customers[customer_idx].time_window.end_time) {
-            total_distance += (current_time - customers[customer_idx].time_window.end_time);
-            current_time = customers[customer_idx].time_window.start_time;
+// Rebuilds the load, position and range caches of one vehicle after its route changed.
+void refresh_vehicle(const SolverContext& context, Solution& solution, int v) {
+    const vector<Node>& nodes = context.nodes;
+    Vehicle& vehicle = solution.vehicles[v];
+    int m = vehicle.route.size();
+    vehicle.load.assign(m + 1, 0);
+    for (int k = 0; k < m; ++k) {
+        int node = vehicle.route[k];
+        vehicle.load[k + 1] = vehicle.load[k] + nodes[node].demand;
+        solution.vehicle_of[node] = v;
+        solution.position_of[node] = k;
+    }
+    vehicle.delivery_position.assign(m, numeric_limits<int>::max());
+    for (int k = 0; k < m; ++k) {
+        int node = vehicle.route[k];
+        if (is_pickup(node)) {
+            vehicle.delivery_position[k] = solution.position_of[nodes[node].pair];
         }
+    }
+    vehicle.max_load.build(vehicle.load);
+    vehicle.min_load.build(vehicle.load);
+    if (m > 0) {
+        vehicle.first_delivery.build(vehicle.delivery_position);
+    }
+}
+
+double calculate_route_cost(const SolverContext& context, const Vehicle& vehicle) {
+    const vrp::DistanceMatrix& distance_matrix = context.distance_matrix;
+    double total_distance = 0.0;
+    int current_location = vehicle.depot;
 
-        total_distance += distance_matrix[customers[customer_idx].pickup.x][customers[customer_idx].pickup.y];
-        current_time += distance_matrix[customers[customer_idx].pickup.x][customers[customer_idx].pickup.y];
-        total_distance += distance_matrix[customers[customer_idx].delivery.x][customers[customer_idx].delivery.y];
-        current_location = customers[customer_idx].delivery;
+    for (int node : vehicle.route) {
+        total_distance += distance_matrix(current_location, node);
+        current_location = node;
     }
 
-    total_distance += distance_matrix[current_location.x][current_location.y];
+    total_distance += distance_matrix(current_location, vehicle.depot);
     return total_distance;
 }
 
-double calculate_solution_cost(const Solution& solution) {
+double calculate_solution_cost(const SolverContext& context, const Solution& solution) {
     double total_cost = 0.0;
     for (const Vehicle& vehicle : solution.vehicles) {
-        total_cost += calculate_route_cost(vehicle);
+        total_cost += calculate_route_cost(context, vehicle);
     }
     return total_cost;
 }
 
-void generate_initial_solution() {
+// Serves each customer with an empty vehicle, picking up and delivering straight away, so
+// the start is feasible whenever every demand fits in a vehicle.
+void generate_initial_solution(SolverContext& context) {
     Solution initial_solution;
+    initial_solution.vehicles.resize(NUM_VEHICLES);
+    initial_solution.vehicle_of.assign(context.nodes.size(), -1);
+    initial_solution.position_of.assign(context.nodes.size(), -1);
+    vector<int> order(NUM_CUSTOMERS);
+    for (int c = 0; c < NUM_CUSTOMERS; ++c) {
+        order[c] = c;
+    }
+    shuffle(order.begin(), order.end(), context.rng);
+
+    for (int i = 0; i < NUM_CUSTOMERS; ++i) {
+        Vehicle& vehicle = initial_solution.vehicles[i % NUM_VEHICLES];
+        vehicle.route.push_back(pickup_node(order[i]));
+        vehicle.route.push_back(delivery_node(order[i]));
+    }
     for (int v = 0; v < NUM_VEHICLES; ++v) {
-        Vehicle vehicle;
-        vehicle.depot = depots[v];
-        vehicle.route.push_back(rand() % NUM_CUSTOMERS);
-        vehicle.route.push_back(rand() % NUM_CUSTOMERS);
-        initial_solution.vehicles.push_back(vehicle);
+        initial_solution.vehicles[v].depot = v;
+        refresh_vehicle(context, initial_solution, v);
     }
-    initial_solution.cost = calculate_solution_cost(initial_solution);
-    best_solution = initial_solution;
-    best_cost = initial_solution.cost;
+    initial_solution.cost = calculate_solution_cost(context, initial_solution);
+    context.best_solution = initial_solution;
+    context.best_cost = initial_solution.cost;
 }
 
-vector<Solution> generate_neighborhood(const Solution& current_solution) {
-    vector<Solution> neighborhood;
-    for (int v = 0; v < NUM_VEHICLES; ++v) {
-        Vehicle current_vehicle = current_solution.vehicles[v];
-        int num_customers = current_vehicle.route.size();
-
-        for (int i = 1; i < num_customers - 1; ++i) {
-            for (int j = i + 1; j < num_customers; ++j) {
-                Vehicle neighbor_vehicle = current_vehicle;
-                reverse(neighbor_vehicle.route.begin() + i, neighbor_vehicle.route.begin() + j);
-                Solution neighbor_solution = current_solution;
-                neighbor_solution.vehicles[v] = neighbor_vehicle;
-                neighbor_solution.cost = calculate_solution_cost(neighbor_solution);
-                neighborhood.push_back(neighbor_solution);
-            }
+// TWO_OPT reverses route positions [begin, end) of `vehicle`, end - begin >= 2.
+// RELOCATE_PAIR moves `customer` to another `vehicle`, inserting its pickup before position
+// begin and its delivery before position end (begin <= end) of that vehicle's route.
+// Distances are symmetric, so both are priced from the arcs at their ends in O(1).
+struct PdpMove {
+    static constexpr const char* kOperators[] = {"two_opt", "relocate_pair"};  // for telemetry, by kind
+    int operatorIndex() const { return kind; }
+
+    enum Kind { TWO_OPT, RELOCATE_PAIR } kind;
+    int vehicle;
+    int begin, end;
+    int customer;
+    double priced_delta = 0.0;  // delta() as of evaluation, kept for commit
+
+    // A reversal keeps pickups before deliveries only if no shipment lies wholly inside it;
+    // its loads are the segment's loads mirrored about load[begin] + load[end]. An inserted
+    // pair adds its demand to every load between the two insertion points.
+    bool feasible(const SolverContext& context, const Solution& solution) const {
+        const Vehicle& v = solution.vehicles[vehicle];
+        if (kind == TWO_OPT) {
+            return v.first_delivery.query(begin, end) >= end
+                && v.load[begin] + v.load[end] - v.min_load.query(begin, end) <= VEHICLE_CAPACITY;
+        }
+        return v.max_load.query(begin, end + 1) + context.customers[customer].demand <= VEHICLE_CAPACITY;
+    }
+
+    double delta(const SolverContext& context, const Solution& solution) const {
+        const vrp::DistanceMatrix& distance_matrix = context.distance_matrix;
+        const Vehicle& v = solution.vehicles[vehicle];
+        if (kind == TWO_OPT) {
+            int before = node_before(v, begin);
+            int after = node_at(v, end);
+            int first = v.route[begin];
+            int last = v.route[end - 1];
+            return distance_matrix(before, last) + distance_matrix(first, after)
+                 - distance_matrix(before, first) - distance_matrix(last, after);
+        }
+        return removal_delta(context, solution) + insertion_delta(context, v);
+    }
+
+    double removal_delta(const SolverContext& context, const Solution& solution) const {
+        const vrp::DistanceMatrix& distance_matrix = context.distance_matrix;
+        int p = pickup_node(customer);
+        int d = delivery_node(customer);
+        const Vehicle& from = solution.vehicles[solution.vehicle_of[p]];
+        int i = solution.position_of[p];
+        int j = solution.position_of[d];
+        int before = node_before(from, i);
+        int after = node_at(from, j + 1);
+        if (j == i + 1) {
+            return distance_matrix(before, after)
+                 - distance_matrix(before, p) - distance_matrix(p, d) - distance_matrix(d, after);
+        }
+        int next = from.route[i + 1];
+        int prev = from.route[j - 1];
+        return distance_matrix(before, next) - distance_matrix(before, p) - distance_matrix(p, next)
+             + distance_matrix(prev, after) - distance_matrix(prev, d) - distance_matrix(d, after);
+    }
+
+    double insertion_delta(const SolverContext& context, const Vehicle& to) const {
+        const vrp::DistanceMatrix& distance_matrix = context.distance_matrix;
+        int p = pickup_node(customer);
+        int d = delivery_node(customer);
+        int before = node_before(to, begin);
+        int at = node_at(to, begin);
+        if (begin == end) {
+            return distance_matrix(before, p) + distance_matrix(p, d) + distance_matrix(d, at) - distance_matrix(before, at);
         }
+        int before_end = node_before(to, end);
+        int at_end = node_at(to, end);
+        return distance_matrix(before, p) + distance_matrix(p, at) - distance_matrix(before, at)
+             + distance_matrix(before_end, d) + distance_matrix(d, at_end) - distance_matrix(before_end, at_end);
     }
-    return neighborhood;
+
+    void apply(const SolverContext& context, Solution& solution) const {
+        Vehicle& v = solution.vehicles[vehicle];
+        if (kind == TWO_OPT) {
+            reverse(v.route.begin() + begin, v.route.begin() + end);
+            refresh_vehicle(context, solution, vehicle);
+            return;
+        }
+        int p = pickup_node(customer);
+        int d = delivery_node(customer);
+        int source = solution.vehicle_of[p];
+        vector<int>& from = solution.vehicles[source].route;
+        from.erase(from.begin() + solution.position_of[d]);
+        from.erase(from.begin() + solution.position_of[p]);
+        v.route.insert(v.route.begin() + end, d);
+        v.route.insert(v.route.begin() + begin, p);
+        refresh_vehicle(context, solution, source);
+        refresh_vehicle(context, solution, vehicle);
+    }
+};
+
+// Draws a reversal within a random vehicle or a pair relocation to another vehicle.
+// Infeasible draws are rejected here, before any pricing.
+bool neighbor_move(const SolverContext& context, const Solution& solution, PdpMove& move, vrp::Rng& rng) {
+    move.vehicle = rng.uniformInt(NUM_VEHICLES);
+    int m = solution.vehicles[move.vehicle].route.size();
+    if (rng.uniformInt(2) == 0) {
+        move.kind = PdpMove::TWO_OPT;
+        if (m < 2) {
+            return false;
+        }
+        // Pairs (begin, end) with end - begin >= 2, drawn by rejection from the m x (m + 1) grid.
+        do {
+            move.begin = rng.uniformInt(m);
+            move.end = rng.uniformInt(m + 1);
+        } while (move.end - move.begin < 2);
+    } else {
+        move.kind = PdpMove::RELOCATE_PAIR;
+        move.customer = rng.uniformInt(NUM_CUSTOMERS);
+        if (solution.vehicle_of[pickup_node(move.customer)] == move.vehicle) {
+            return false;
+        }
+        move.begin = rng.uniformInt(m + 1);
+        move.end = rng.uniformInt(m + 1);
+        if (move.begin > move.end) {
+            swap(move.begin, move.end);
+        }
+    }
+    return move.feasible(context, solution);
 }
 
-void simulated_annealing(double initial_temperature, double cooling_rate, int iterations) {
-    srand(time(nullptr));
-    double temperature = initial_temperature;
-    Solution current_solution;
-    generate_initial_solution();
+// Walks every feasible reversal of a solution one move at a time, for descent.
+class TwoOptEnumerator {
+public:
+    TwoOptEnumerator(const SolverContext& context, const Solution& solution) : context_(context), solution_(solution) {
+        move_ = {PdpMove::TWO_OPT, 0, 0, 1, -1};
+    }
 
-    while (temperature > 1e-6) {
-        for (int i = 0; i < iterations; ++i) {
-            int vehicle_index = rand() % NUM_VEHICLES;
-            current_solution = best_solution;
-            vector<Solution> neighborhood = generate_neighborhood(current_solution);
-            Solution neighbor_solution = neighborhood[rand() % neighborhood.size()];
-            double delta_cost = neighbor_solution.cost - current_solution.cost;
-            if (delta_cost < 0 || exp(-delta_cost / temperature) > (double)rand() / RAND_MAX) {
-                best_solution = neighbor_solution;
-                best_cost += delta_cost;
+    bool next(PdpMove& move) {
+        while (move_.vehicle < (int)solution_.vehicles.size()) {
+            int m = solution_.vehicles[move_.vehicle].route.size();
+            if (++move_.end > m) {
+                ++move_.begin;
+                move_.end = move_.begin + 2;
+            }
+            if (move_.end > m) {
+                move_ = {PdpMove::TWO_OPT, move_.vehicle + 1, 0, 1, -1};
+            } else if (move_.feasible(context_, solution_)) {
+                move = move_;
+                return true;
             }
         }
-        temperature *= cooling_rate;
+        return false;
     }
-}
 
-int main() {
-    for (int i = 0; i < NUM_CUSTOMERS; ++i) {
-        customers[i].pickup.x = rand() % 100;
-        customers[i].pickup.y = rand() % 100;
-        customers[i].delivery.x = rand() % 100;
-        customers[i].delivery.y = rand() % 100;
-        customers[i].time_window.start_time = rand() % 100;
-        customers[i].time_window.end_time = customers[i].time_window.start_time + rand() % 100;
+private:
+    const SolverContext& context_;
+    const Solution& solution_;
+    PdpMove move_;
+};
+
+// Applies the best improving reversal until there is none.
+void two_opt_descent(const SolverContext& context, Solution& solution) {
+    while (true) {
+        PdpMove best_move{}, move{};
+        double best_delta = -1e-9;
+        TwoOptEnumerator moves(context, solution);
+        while (moves.next(move)) {
+            double delta = move.delta(context, solution);
+            if (delta < best_delta) {
+                best_delta = delta;
+                best_move = move;
+            }
+        }
+        if (best_delta >= -1e-9) {
+            return;
+        }
+        best_move.apply(context, solution);
+        solution.cost += best_delta;
     }
+}
 
-    for (int i = 0; i < NUM_VEHICLES; ++i) {
-        depots[i].x = rand() % 100;
-        depots[i].y = rand() % 100;
+struct VrppdProblem {
+    using Solution = ::Solution;
+
+    const SolverContext* context;
+    Solution current;
+
+    VrppdProblem(const SolverContext& context, const Solution& initial) : context(&context), current(initial) {}
+
+    double cost() const { return current.cost; }
+    const Solution& solution() const { return current; }
+    void load(const Solution& solution) { current = solution; }
+
+    bool propose(PdpMove& move, vrp::Rng& rng) { return neighbor_move(*context, current, move, rng); }
+    double evaluate(PdpMove& move) {
+        move.priced_delta = move.delta(*context, current);
+        return move.priced_delta;
+    }
+    void commit(PdpMove& move) {
+        current.cost += move.priced_delta;
+        move.apply(*context, current);
     }
+    void revert(PdpMove&) {}
+    void resync() { current.cost = calculate_solution_cost(*context, current); }
+};
 
-    calculate_distance_matrix();
+// Runs parallel.num_chains chains, each from its own initial solution, under an adaptive
+// schedule spread over MAX_ITERATIONS or the time left before the deadline, then polishes the best solution with 2-opt descent and leaves it in the context. The trace
+// numbers the chains of `instance` from instance * parallel.num_chains.
+void simulated_annealing(SolverContext& context, const vrp::AnytimeOptions& anytime, vrp::ProgressStream& progress, vrp::TraceWriter& trace,
+                         const vrp::ParallelOptions& parallel, int instance) {
+    using Annealer = vrp::Annealer<VrppdProblem, PdpMove, vrp::AdaptiveSchedule>;
+    Annealer::Options options;
+    anytime.configure(options, progress);
+    vrp::AdaptiveScheduleOptions schedule = vrp::AdaptiveScheduleOptions::budget(MAX_ITERATIONS, anytime.deadline.remaining());
+    vector<Annealer> chains;
+    for (int i = 0; i < parallel.num_chains; ++i) {
+        generate_initial_solution(context);
+        trace.configure(options, instance * parallel.num_chains + i);
+        chains.emplace_back(VrppdProblem(context, context.best_solution), vrp::AdaptiveSchedule(INITIAL_TEMPERATURE, schedule),
+                            context.rng.split(), options);
+        chains.back().calibrateTemperature(schedule.initial_acceptance);
+    }
+    int best_chain = vrp::runChains(chains, anytime.iterationBudget(MAX_ITERATIONS), parallel, context.rng);
 
-    simulated_annealing(100.0, 0.99, 1000);
+    context.best_solution = chains[best_chain].best();
+    two_opt_descent(context, context.best_solution);
+    context.best_cost = context.best_solution.cost;
+}
 
-    cout << "Best solution cost: " << best_cost << endl;
+void print_solution(const SolverContext& context) {
+    cout << "Best solution cost: " << context.best_cost << endl;
     for (int v = 0; v < NUM_VEHICLES; ++v) {
         cout << "Vehicle " << v << " route: ";
-        for (int customer_idx : best_solution.vehicles[v].route) {
-            cout << customer_idx << " ";
+        for (int node : context.best_solution.vehicles[v].route) {
+            int customer_idx = (node - NUM_VEHICLES) / 2;
+            cout << (is_pickup(node) ? "P" : "D") << customer_idx << " ";
         }
         cout << endl;
     }
+}
+
+// --instances N solves N independent random instances concurrently, one context each, and
+// --chains N runs N chains per instance. A --time-limit is one deadline that every instance
+// must meet.
+int main(int argc, char** argv) {
+    vrp::Rng rng(vrp::seedArg(argc, argv, vrp::timeSeed()));
+    vrp::AnytimeOptions anytime = vrp::anytimeOptionsFromArgs(argc, argv);
+    vrp::ParallelOptions parallel = vrp::parallelOptionsFromArgs(argc, argv, 10000);
+    int num_instances = max(1, vrp::intArg(argc, argv, "--instances", 1));
+
+    vector<SolverContext> contexts;
+    deque<vrp::ProgressStream> streams;
+    vrp::TraceWriter trace = vrp::traceFromArgs<PdpMove>(argc, argv);
+    contexts.reserve(num_instances);
+    for (int k = 0; k < num_instances; ++k) {
+        contexts.emplace_back(rng.split());
+        streams.emplace_back(num_instances > 1 ? k : -1);
+    }
+
+    auto solve = [&](int k) { simulated_annealing(contexts[k], anytime, streams[k], trace, parallel, k); };
+    if (num_instances == 1) {
+        solve(0);
+    } else {
+        vrp::ThreadPool pool(min<unsigned>(num_instances, max(1u, thread::hardware_concurrency())));
+        pool.parallelFor(num_instances, solve);
+    }
+
+    for (int k = 0; k < num_instances; ++k) {
+        if (num_instances > 1) {
+            cout << "Instance " << k << endl;
+        }
+        print_solution(contexts[k]);
+    }
 
     return 0;
 }
@@ -2,13 +2,24 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include <ctime>
-#include <cstdlib>
 #include <algorithm>
+#include <limits>
+#include "common/adaptive_schedule.h"
+#include "common/annealer.h"
+#include "common/anytime.h"
+#include "common/cli.h"
+#include "common/distance_matrix.h"
+#include "common/instances.h"
+#include "common/neighbor_lists.h"
+#include "common/parallel_annealing.h"
+#include "common/report.h"
+#include "common/rng.h"
+#include "common/time_windows.h"
 using namespace std;
 const int MAX_ITER = 10000;
-const double INITIAL_TEMPERATURE = 1000.0;
-const double COOLING_RATE = 0.99;
+const double INITIAL_TEMPERATURE = 1000.0;  // replaced by calibration when a sampled move goes uphill
+const int NEIGHBOR_LIST_SIZE = 10;
+const int DRIFT_CHECK_INTERVAL = 1000;
 struct Point {
     double x, y;
 };
@@ -22,112 +33,294 @@ struct Customer {
 struct Vehicle {
     int capacity;
 };
+// Time windows, waiting and capacity are priced through the prefix/suffix segments of each
+// route, so every move is evaluated in O(1). Violations are penalised rather than
+// forbidden, which lets the search cross infeasible regions; WAITING_WEIGHT is 0 because
+// the Solomon objective is distance alone.
+const double TIME_WARP_PENALTY = 100.0;
+const double LOAD_PENALTY = 100.0;
+const double WAITING_WEIGHT = 0.0;
 struct Solution {
     vector<vector<int>> routes;
+    vrp::RoutePositions positions;
+    vector<vrp::RouteSegments> segments;
+    vector<double> route_costs;
     double cost;
 };
 vector<Customer> customers;
+Point depot = {0.0, 0.0};
+double depot_ready = 0.0;
+double depot_due = numeric_limits<double>::infinity();
 Vehicle vehicle;
 int num_vehicles;
-double euclideanDistance(Point a, Point b);
-double calculateTotalCost(const vector<vector<int>>& routes);
-Solution generateInitialSolution();
-Solution neighborSolution(const Solution& current_solution);
-bool acceptNeighbor(double current_cost, double neighbor_cost, double temperature);
-double anneal(Solution& initial_solution);
-double euclideanDistance(Point a, Point b) {
-    return sqrt(pow(a.x - b.x, 2) + pow(a.y - b.y, 2));
+vrp::NeighborLists neighbors;
+vrp::DistanceMatrix dist;  // customers first, the depot in the last row
+int depotNode();
+vrp::TimeWindowSegment stopSegment(int node);
+double segmentCost(const vrp::TimeWindowSegment& segment);
+void refreshRoute(Solution& solution, int route, int from, int to);
+void rebuildCaches(Solution& solution);
+Solution generateInitialSolution(vrp::Rng& rng);
+struct VrptwMove;
+bool neighborMove(const Solution& current_solution, VrptwMove& move, vrp::Rng& rng);
+struct VrptwProblem;
+int anneal(vector<vrp::Annealer<VrptwProblem, VrptwMove, vrp::AdaptiveSchedule>>& chains, const vrp::AnytimeOptions& anytime,
+          vrp::ProgressStream& progress, vrp::TraceWriter& trace, const vrp::ParallelOptions& parallel, vrp::Rng& rng);
+void loadInstance(const vrp::SolomonInstance& instance);
+int depotNode() {
+    return customers.size();
 }
-double calculateTotalCost(const vector<vector<int>>& routes) {
-    double total_cost = 0.0;
-    for (const auto& route : routes) {
-        if (route.size() > 0) {
-            Point prev_location = {0.0, 0.0};
-            for (int i = 0; i < route.size(); ++i) {
-                int customer_index = route[i];
-                Point current_location = customers[customer_index].location;
-                total_cost += euclideanDistance(prev_location, current_location);
-                prev_location = current_location;
-            }
-            total_cost += euclideanDistance(prev_location, {0.0, 0.0});
-        }
+vrp::TimeWindowSegment stopSegment(int node) {
+    if (node == depotNode()) {
+        return vrp::TimeWindowSegment::node(node, depot_ready, depot_due, 0.0, 0);
+    }
+    const Customer& c = customers[node];
+    return vrp::TimeWindowSegment::node(node, c.ready_time, c.due_time, c.service_time, c.demand);
+}
+double travel(int from, int to) {
+    return dist(from, to);
+}
+double segmentCost(const vrp::TimeWindowSegment& segment) {
+    return segment.distance + WAITING_WEIGHT * segment.waiting() + TIME_WARP_PENALTY * segment.time_warp
+         + LOAD_PENALTY * max(0, segment.load - vehicle.capacity);
+}
+// Recomputes the segments a change between positions from and to invalidated, and the route's cost.
+void refreshRoute(Solution& solution, int route, int from, int to) {
+    solution.segments[route].update(solution.routes[route], stopSegment(depotNode()), stopSegment, travel, from, to);
+    solution.route_costs[route] = segmentCost(solution.segments[route].whole());
+}
+void rebuildCaches(Solution& solution) {
+    solution.positions.rebuild(solution.routes, customers.size());
+    solution.segments.assign(solution.routes.size(), vrp::RouteSegments());
+    solution.route_costs.assign(solution.routes.size(), 0.0);
+    solution.cost = 0.0;
+    for (int r = 0; r < solution.routes.size(); ++r) {
+        refreshRoute(solution, r, 0, solution.routes[r].size());
+        solution.cost += solution.route_costs[r];
     }
-    return total_cost;
 }
-Solution generateInitialSolution() {
+Solution generateInitialSolution(vrp::Rng& rng) {
     Solution initial_solution;
     initial_solution.routes.resize(num_vehicles);
     vector<int> customer_indices(customers.size());
     for (int i = 0; i < customers.size(); ++i) {
         customer_indices[i] = i;
     }
-    random_shuffle(customer_indices.begin(), customer_indices.end());
+    shuffle(customer_indices.begin(), customer_indices.end(), rng);
     int vehicle_index = 0;
     for (int i = 0; i < customer_indices.size(); ++i) {
         int customer_index = customer_indices[i];
         initial_solution.routes[vehicle_index].push_back(customer_index);
         vehicle_index = (vehicle_index + 1) % num_vehicles;
     }
-    initial_solution.cost = calculateTotalCost(initial_solution.routes);
+    rebuildCaches(initial_solution);
 
     return initial_solution;
 }
-Solution neighborSolution(const Solution& current_solution) {
-    Solution neighbor_solution = current_solution;
-    int route1 = rand() % num_vehicles;
-    int route2 = rand() % num_vehicles;
-    while (route1 == route2 || neighbor_solution.routes[route1].empty() || neighbor_solution.routes[route2].empty()) {
-        route1 = rand() % num_vehicles;
-        route2 = rand() % num_vehicles;
-    }
-    int index1 = rand() % neighbor_solution.routes[route1].size();
-    int index2 = rand() % neighbor_solution.routes[route2].size();
-    int customer1 = neighbor_solution.routes[route1][index1];
-    int customer2 = neighbor_solution.routes[route2][index2];
-    neighbor_solution.routes[route1][index1] = customer2;
-    neighbor_solution.routes[route2][index2] = customer1;
-    neighbor_solution.cost = calculateTotalCost(neighbor_solution.routes);
-    return neighbor_solution;
-}
-bool acceptNeighbor(double current_cost, double neighbor_cost, double temperature) {
-    if (neighbor_cost < current_cost) {
-        return true;
+// A swap exchanges route1[index1] and route2[index2]; a relocation moves route1[index1] so
+// that it sits at route2[index2]. evaluate() joins cached segments around the touched
+// positions, three concatenations per route, and commit() applies the move.
+struct VrptwMove {
+    static constexpr const char* kOperators[] = {"swap", "relocate"};  // for telemetry, by kind
+    int operatorIndex() const { return kind; }
+
+    enum Kind { SWAP, RELOCATE } kind;
+    int route1, index1;
+    int route2, index2;
+    double delta;
+    double evaluate(const Solution& solution) const {
+        const vrp::RouteSegments& s1 = solution.segments[route1];
+        const vrp::RouteSegments& s2 = solution.segments[route2];
+        int a = solution.routes[route1][index1];
+        vrp::TimeWindowSegment new1, new2;
+        if (kind == SWAP) {
+            int b = solution.routes[route2][index2];
+            new1 = replaced(s1, index1, b);
+            new2 = replaced(s2, index2, a);
+        } else {
+            new1 = vrp::concat(s1.forward[index1], s1.backward[index1 + 1], travel(s1.forward[index1].last, s1.backward[index1 + 1].first));
+            vrp::TimeWindowSegment head = vrp::concat(s2.forward[index2], stopSegment(a), travel(s2.forward[index2].last, a));
+            new2 = vrp::concat(head, s2.backward[index2], travel(a, s2.backward[index2].first));
+        }
+        return segmentCost(new1) + segmentCost(new2) - solution.route_costs[route1] - solution.route_costs[route2];
+    }
+    static vrp::TimeWindowSegment replaced(const vrp::RouteSegments& s, int index, int node) {
+        vrp::TimeWindowSegment head = vrp::concat(s.forward[index], stopSegment(node), travel(s.forward[index].last, node));
+        return vrp::concat(head, s.backward[index + 1], travel(node, s.backward[index + 1].first));
+    }
+    void apply(Solution& solution) const {
+        vector<int>& r1 = solution.routes[route1];
+        vector<int>& r2 = solution.routes[route2];
+        if (kind == SWAP) {
+            swap(r1[index1], r2[index2]);
+            solution.positions.place(r1[index1], route1, index1);
+            solution.positions.place(r2[index2], route2, index2);
+            refreshRoute(solution, route1, index1, index1);
+            refreshRoute(solution, route2, index2, index2);
+        } else {
+            int a = r1[index1];
+            r1.erase(r1.begin() + index1);
+            r2.insert(r2.begin() + index2, a);
+            for (int i = index1; i < r1.size(); ++i) {
+                solution.positions.place(r1[i], route1, i);
+            }
+            for (int i = index2; i < r2.size(); ++i) {
+                solution.positions.place(r2[i], route2, i);
+            }
+            // Suffixes past the change keep their segments, one place along; only the prefixes
+            // from the change on and the suffixes up to it are recomputed.
+            vector<vrp::TimeWindowSegment>& backward1 = solution.segments[route1].backward;
+            vector<vrp::TimeWindowSegment>& backward2 = solution.segments[route2].backward;
+            backward1.erase(backward1.begin() + index1);
+            backward2.insert(backward2.begin() + index2, vrp::TimeWindowSegment());
+            refreshRoute(solution, route1, index1, index1 - 1);
+            refreshRoute(solution, route2, index2, index2);
+        }
+        solution.cost += delta;
+    }
+};
+// The second customer is drawn from the first one's nearest-neighbour list. Half the moves
+// swap the pair, the other half move the first customer next to its partner. A partner on
+// the same route turns the move into a relocation to a random place on another route;
+// otherwise a route emptied at high temperature could never be refilled, and a search that
+// had gathered every customer onto one route would be stuck there.
+bool neighborMove(const Solution& current_solution, VrptwMove& move, vrp::Rng& rng) {
+    move.route1 = rng.uniformInt(num_vehicles);
+    if (current_solution.routes[move.route1].empty() || neighbors.k() == 0) {
+        return false;
+    }
+    move.index1 = rng.uniformInt(current_solution.routes[move.route1].size());
+    int partner = neighbors.of(current_solution.routes[move.route1][move.index1])[rng.uniformInt(neighbors.k())];
+    move.route2 = current_solution.positions.route[partner];
+    move.index2 = current_solution.positions.index[partner];
+    if (move.route2 == move.route1) {
+        if (num_vehicles < 2) {
+            return false;
+        }
+        move.kind = VrptwMove::RELOCATE;
+        move.route2 = (move.route1 + 1 + rng.uniformInt(num_vehicles - 1)) % num_vehicles;
+        move.index2 = rng.uniformInt(current_solution.routes[move.route2].size() + 1);
+    } else if (rng.uniformInt(2) == 0) {
+        move.kind = VrptwMove::SWAP;
     } else {
-        double acceptance_probability = exp((current_cost - neighbor_cost) / temperature);
-        double rand_num = ((double) rand() / (RAND_MAX));
-        return rand_num < acceptance_probability;
+        move.kind = VrptwMove::RELOCATE;
+        move.index2 += rng.uniformInt(2);
     }
+    return true;
 }
-double anneal(Solution& initial_solution) {
-    Solution current_solution = initial_solution;
-    double current_cost = initial_solution.cost;
-    double temperature = INITIAL_TEMPERATURE;
-    int iteration = 0;
-    while (temperature > 1.0 && iteration < MAX_ITER) {
-        Solution neighbor = neighborSolution(current_solution);
-        double neighbor_cost = neighbor.cost;
-        if (acceptNeighbor(current_cost, neighbor_cost, temperature)) {
-            current_solution = neighbor;
-            current_cost = neighbor_cost;
-        }
-        temperature *= COOLING_RATE;
-        iteration++;
+// The current solution with its segment caches. Moves are priced in O(1) and only applied,
+// refreshing the two touched routes, once accepted.
+struct VrptwProblem {
+    using Solution = ::Solution;
+    Solution current;
+    explicit VrptwProblem(const Solution& initial) : current(initial) {}
+    double cost() const { return current.cost; }
+    const Solution& solution() const { return current; }
+    void load(const Solution& solution) { current = solution; }
+    bool propose(VrptwMove& move, vrp::Rng& rng) { return neighborMove(current, move, rng); }
+    double evaluate(VrptwMove& move) {
+        move.delta = move.evaluate(current);
+        return move.delta;
+    }
+    void commit(VrptwMove& move) { move.apply(current); }
+    void revert(VrptwMove&) {}
+    void resync() { rebuildCaches(current); }
+};
+// Each chain cools from a calibrated start over MAX_ITER moves, or until the deadline when
+// there is one. Returns the index of the chain holding the best solution.
+int anneal(vector<vrp::Annealer<VrptwProblem, VrptwMove, vrp::AdaptiveSchedule>>& chains, const vrp::AnytimeOptions& anytime,
+          vrp::ProgressStream& progress, vrp::TraceWriter& trace, const vrp::ParallelOptions& parallel, vrp::Rng& rng) {
+    using Annealer = vrp::Annealer<VrptwProblem, VrptwMove, vrp::AdaptiveSchedule>;
+    Annealer::Options options;
+    options.resync_interval = DRIFT_CHECK_INTERVAL;
+    anytime.configure(options, progress);
+    vrp::AdaptiveScheduleOptions schedule = vrp::AdaptiveScheduleOptions::budget(MAX_ITER, anytime.deadline.remaining());
+    for (int i = 0; i < parallel.num_chains; ++i) {
+        vrp::Rng chain_rng = rng.split();
+        trace.configure(options, i);
+        chains.emplace_back(VrptwProblem(generateInitialSolution(chain_rng)), vrp::AdaptiveSchedule(INITIAL_TEMPERATURE, schedule), chain_rng, options);
+        chains.back().calibrateTemperature(schedule.initial_acceptance);
     }
-    return current_cost;
+    return vrp::runChains(chains, anytime.iterationBudget(MAX_ITER), parallel, rng);
 }
-int main() {
-    srand(time(NULL)); 
-    num_vehicles = 3;
-    vehicle.capacity = 100;
-    customers = {
-        {{10.0, 10.0}, 5, 0.0, 100.0, 0.0},    
-        {{20.0, 20.0}, 10, 0.0, 100.0, 0.0},
-        {{30.0, 30.0}, 7, 0.0, 100.0, 0.0},
-        {{15.0, 15.0}, 12, 0.0, 100.0, 0.0},
-        {{25.0, 25.0}, 8, 0.0, 100.0, 0.0}
-    };
-    Solution initial_solution = generateInitialSolution();
-    double best_cost = anneal(initial_solution);
-    cout << "Best cost found: " << best_cost << endl;
+// Customer 0 of a Solomon file is the depot.
+void loadInstance(const vrp::SolomonInstance& instance) {
+    depot = {instance.customers[0].x, instance.customers[0].y};
+    depot_ready = instance.customers[0].ready_time;
+    depot_due = instance.customers[0].due_time;
+    num_vehicles = instance.vehicles;
+    vehicle.capacity = instance.capacity;
+    customers.clear();
+    for (int i = 1; i < instance.customers.size(); ++i) {
+        const vrp::SolomonInstance::Customer& c = instance.customers[i];
+        customers.push_back({{c.x, c.y}, c.demand, c.ready_time, c.due_time, c.service_time});
+    }
+}
+int main(int argc, char** argv) {
+    uint64_t seed = vrp::seedArg(argc, argv, vrp::timeSeed());
+    vrp::Rng rng(seed);
+    vrp::ParallelOptions parallel = vrp::parallelOptionsFromArgs(argc, argv, 100);
+    string instance_path = vrp::stringArg(argc, argv, "--instance", "");
+    vrp::AnytimeOptions anytime = vrp::anytimeOptionsFromArgs(argc, argv);
+    bool json = vrp::hasFlag(argc, argv, "--json");
+    string instance_name = "example";
+    if (!instance_path.empty()) {
+        try {
+            vrp::SolomonInstance instance = vrp::loadSolomon(instance_path);
+            instance_name = instance.name;
+            loadInstance(instance);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    } else {
+        num_vehicles = 3;
+        vehicle.capacity = 100;
+        customers = {
+            {{10.0, 10.0}, 5, 0.0, 100.0, 0.0},    
+            {{20.0, 20.0}, 10, 0.0, 100.0, 0.0},
+            {{30.0, 30.0}, 7, 0.0, 100.0, 0.0},
+            {{15.0, 15.0}, 12, 0.0, 100.0, 0.0},
+            {{25.0, 25.0}, 8, 0.0, 100.0, 0.0}
+        };
+    }
+    vector<Point> locations;
+    for (const auto& customer : customers) {
+        locations.push_back(customer.location);
+    }
+    neighbors = vrp::NeighborLists::build(locations, NEIGHBOR_LIST_SIZE);
+    locations.push_back(depot);
+    dist = vrp::DistanceMatrix::euclidean(locations);
+    vrp::TraceWriter trace = vrp::traceFromArgs<VrptwMove>(argc, argv);  // outlives the chains, which flush into it
+    vector<vrp::Annealer<VrptwProblem, VrptwMove, vrp::AdaptiveSchedule>> chains;
+    vrp::Stopwatch stopwatch;
+    vrp::ProgressStream progress;
+    int best_chain = anneal(chains, anytime, progress, trace, parallel, rng);
+    double elapsed = stopwatch.seconds();
+    Solution best_solution = chains[best_chain].best();
+    rebuildCaches(best_solution);
+    double distance = 0.0, time_warp = 0.0, waiting = 0.0;
+    bool overloaded = false;
+    for (const vrp::RouteSegments& route : best_solution.segments) {
+        distance += route.whole().distance;
+        time_warp += route.whole().time_warp;
+        waiting += route.whole().waiting();
+        overloaded = overloaded || route.whole().load > vehicle.capacity;
+    }
+    bool feasible = time_warp == 0.0 && !overloaded;
+    if (json) {
+        vrp::RunReport report;
+        report.solver = "vrptw";
+        report.instance = instance_name;
+        report.seed = seed;
+        report.collect(chains, best_chain, elapsed);
+        report.best_cost = distance;
+        report.feasible = feasible;
+        report.print();
+        return 0;
+    }
+    cout << "Best cost found: " << best_solution.cost << endl;
+    cout << "Distance: " << distance << ", waiting: " << waiting << ", time warp: " << time_warp
+         << (feasible ? " (feasible)" : " (infeasible)") << endl;
     return 0;
 }
@@ -0,0 +1,81 @@
+%% Convergence plots from a solver trace (built with -DVRP_TELEMETRY=ON, run with --trace FILE)
+function plot_trace(filename)
+    if endsWith(filename, '.json') || endsWith(filename, '.jsonl')
+        trace = readJsonTrace(filename);
+    else
+        trace = readtable(filename);
+    end
+    names = trace.Properties.VariableNames;
+    operators = regexprep(names(endsWith(names, '_proposed')), '_proposed$', '');
+    chains = unique(trace.chain)';
+    figure;
+    subplot(2, 2, 1);
+    hold on;
+    for c = chains
+        rows = trace.chain == c;
+        plot(trace.iteration(rows), trace.current_cost(rows), ':');
+        plot(trace.iteration(rows), trace.best_cost(rows), '-', 'LineWidth', 1.5);
+    end
+    hold off;
+    title('Current (dotted) and best cost');
+    xlabel('Iteration');
+    ylabel('Cost');
+    subplot(2, 2, 2);
+    hold on;
+    for c = chains
+        rows = trace.chain == c;
+        plot(trace.iteration(rows), trace.temperature(rows));
+    end
+    set(gca, 'YScale', 'log');
+    hold off;
+    title('Temperature');
+    xlabel('Iteration');
+    subplot(2, 2, 3);
+    hold on;
+    for c = chains
+        rows = trace.chain == c;
+        plot(trace.iteration(rows), trace.acceptance(rows));
+    end
+    hold off;
+    title('Acceptance rate between samples');
+    xlabel('Iteration');
+    ylim([0 1]);
+    subplot(2, 2, 4);
+    % Counters are running totals per chain; the last sample of each chain holds its totals.
+    totals = zeros(numel(operators), 4);
+    for c = chains
+        last = find(trace.chain == c, 1, 'last');
+        for k = 1:numel(operators)
+            op = operators{k};
+            totals(k, :) = totals(k, :) + [trace.([op '_proposed'])(last), trace.([op '_accepted'])(last), ...
+                                           trace.([op '_improving'])(last), trace.([op '_new_best'])(last)];
+        end
+    end
+    bar(totals ./ max(totals(:, 1), 1));
+    set(gca, 'XTick', 1:numel(operators), 'XTickLabel', strrep(operators, '_', ' '));
+    legend('Proposed', 'Accepted', 'Improving', 'New best', 'Location', 'Best');
+    title('Moves per operator, as a share of proposals');
+    fprintf('%-16s %12s %12s %12s %12s\n', 'operator', 'proposed', 'accepted', 'improving', 'new best');
+    for k = 1:numel(operators)
+        fprintf('%-16s %12d %12d %12d %12d\n', operators{k}, totals(k, :));
+    end
+end
+
+% JSON-lines traces flattened into the same columns as the CSV format.
+function trace = readJsonTrace(filename)
+    lines = strsplit(strtrim(fileread(filename)), newline);
+    rows = cell(numel(lines), 1);
+    for i = 1:numel(lines)
+        sample = jsondecode(lines{i});
+        operators = fieldnames(sample.operators);
+        for k = 1:numel(operators)
+            counters = sample.operators.(operators{k});
+            sample.([operators{k} '_proposed']) = counters.proposed;
+            sample.([operators{k} '_accepted']) = counters.accepted;
+            sample.([operators{k} '_improving']) = counters.improving;
+            sample.([operators{k} '_new_best']) = counters.new_best;
+        end
+        rows{i} = rmfield(sample, 'operators');
+    end
+    trace = struct2table([rows{:}]');
+end